@@ -18,13 +18,172 @@
 #include "wan_lan_pci_status.h"
 #include "debug_serial.h"
 #include "eeprom.h"
+#include "telemetry.h"
+#include "gesture.h"
+#include "scheduler.h"
+#include "profile.h"
+#include "ram_monitor.h"
+#include "reset_cause.h"
+#include "trace.h"
 
 #define MAX_ERROR_COUNT            5
+#define CPU_LOAD_WINDOW            1000 /* ms */
+#define EEPROM_TASK_PERIOD         100 /* ms */
+#define EEPROM_QUIET_PERIOD        1000 /* ms, settings are written after no change for it */
 #define SET_INTERRUPT_TO_CPU       GPIO_ResetBits(INT_MCU_PIN_PORT, INT_MCU_PIN)
 #define RESET_INTERRUPT_TO_CPU     GPIO_SetBits(INT_MCU_PIN_PORT, INT_MCU_PIN)
 
 extern void start_bootloader(void);
 
+enum app_tasks {
+    TASK_SYSTEM,                /* power on, resets and errors */
+    TASK_INPUT,
+    TASK_I2C,
+    TASK_LED,
+    TASK_TELEMETRY,
+    TASK_EEPROM,
+    TASK_COUNT
+};
+
+static void system_task(void);
+static void input_task(void);
+static void i2c_task(void);
+static void led_task(void);
+static void eeprom_task(void);
+
+/* handler, period [ms], trigger events, state */
+static struct st_task app_tasks[TASK_COUNT] = {
+    { system_task,          0,                  0,                  { 0 } },
+    { input_task,           5,                  APP_EVENT_INPUT,    { 0 } },
+    { i2c_task,             5,                  APP_EVENT_I2C,      { 0 } },
+    { led_task,             10,                 0,                  { 0 } },
+    { telemetry_update,     TELEMETRY_PERIOD,   0,                  { 0 } },
+    { eeprom_task,          EEPROM_TASK_PERIOD, 0,                  { 0 } },
+};
+
+static states_t system_state = POWER_ON;
+static ret_value_t system_error = OK;
+
+static volatile uint8_t app_events;
+static uint32_t sleep_cycles; /* SysTick cycles spent in WFI in this window */
+static uint32_t load_window_start;
+static uint16_t cpu_load;
+
+/*******************************************************************************
+  * @function   app_post_event
+  * @brief      Wake up the main loop. Can be called from any interrupt.
+  * @param      event: source of the work.
+  * @retval     None.
+  *****************************************************************************/
+void app_post_event(app_event_t event)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    app_events |= event;
+    __set_PRIMASK(primask);
+}
+
+/*******************************************************************************
+  * @function   app_get_cpu_load
+  * @brief      CPU duty cycle of the main loop measured over the last second.
+  * @param      None.
+  * @retval     Busy time in 0.1 % units (0 - 1000).
+  *****************************************************************************/
+uint16_t app_get_cpu_load(void)
+{
+    return cpu_load;
+}
+
+/*******************************************************************************
+  * @function   app_update_cpu_load
+  * @brief      Evaluate CPU duty cycle at the end of each measuring window.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+static void app_update_cpu_load(void)
+{
+    uint32_t window, idle;
+
+    window = delay_get_uptime() - load_window_start;
+
+    if (window < CPU_LOAD_WINDOW)
+        return;
+
+    /* idle time in 0.1 % of the window */
+    idle = sleep_cycles / (window * (SystemCoreClock / 1000000u));
+
+    cpu_load = (idle < 1000) ? 1000 - idle : 0;
+    sleep_cycles = 0;
+    profile_update(window);
+    ram_monitor_scan();
+    load_window_start += window;
+}
+
+/*******************************************************************************
+  * @function   app_wait_for_event
+  * @brief      Sleep until an interrupt posts some work for the main loop.
+  *             The interrupts are disabled around WFI so no event can be lost
+  *             between the check and the sleep (WFI wakes up anyway).
+  * @param      None.
+  * @retval     Posted events.
+  *****************************************************************************/
+static uint8_t app_wait_for_event(void)
+{
+    uint32_t start, end;
+    uint8_t events;
+
+    __disable_irq();
+
+    while (!app_events)
+    {
+        start = SysTick->VAL;
+        __WFI();
+        end = SysTick->VAL;
+
+        /* SysTick counts down and wakes us at least once per reload */
+        if (start >= end)
+            sleep_cycles += start - end;
+        else
+            sleep_cycles += start + SysTick->LOAD + 1 - end;
+
+        __enable_irq(); /* serve the pending interrupt */
+        __disable_irq();
+    }
+
+    events = app_events;
+    app_events = 0;
+
+    __enable_irq();
+
+    app_update_cpu_load();
+
+    return events;
+}
+
+/*******************************************************************************
+  * @function   app_usb_timeout_handler
+  * @brief      USB recovery timeout, runs every 100 ms while a USB port
+  *             recovers from overcurrent.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+static void app_usb_timeout_handler(void)
+{
+    struct st_i2c_status *i2c_control = &i2c_status;
+    uint8_t powered;
+
+    powered = power_control_usb_timeout_handler();
+
+    if (powered & (1 << USB3_PORT0))
+        i2c_control->status_word |= USB30_PWRON_STSBIT;
+
+    if (powered & (1 << USB3_PORT1))
+        i2c_control->status_word |= USB31_PWRON_STSBIT;
+
+    app_post_event(APP_EVENT_INPUT);
+}
+
 /*******************************************************************************
   * @function   app_mcu_init
   * @brief      Initialization of MCU and its ports and peripherals.
@@ -65,16 +224,41 @@ void app_mcu_init(void)
             break;
     }
 
+    ee_var = EE_ReadVariable(WDG_TIMEOUT_VIRT_ADDR, &ee_data);
+
+    if ((ee_var == VAR_FOUND) && (ee_data != 0))
+        wdg->watchdog_timeout = ee_data;
+    else
+        wdg->watchdog_timeout = WATCHDOG_DEFAULT_TIMEOUT;
+
+    /* watchdog resets are counted by reset causes */
+    if (reset_cause_get_flags() & RESET_FLAG_IWDG)
+        DBG("Init - WDG reset\r\n");
+
+    if (reset_cause_get_fw() == RESET_FW_HARD_FAULT)
+        DBG("Init - HardFault reset\r\n");
+
+    reset_cause_count();
+    trace_event(TRACE_BOOT, reset_cause_get());
+    delay_iwdg_config();
+
     delay_systimer_config();
+    profile_config();
     /* init ports and peripheral */
     power_control_io_config();
     msata_pci_indication_config();
     wan_lan_pci_config();
-    power_control_usb_timeout_config();
+    power_control_usb_timeout_config(app_usb_timeout_handler);
     led_config();
     slave_i2c_config();
+    telemetry_config();
     debug_serial_config();
 
+    scheduler_init(app_tasks, TASK_COUNT);
+    scheduler_enable(TASK_SYSTEM, ENABLE);
+    scheduler_enable(TASK_TELEMETRY, ENABLE);
+    scheduler_trigger(TASK_SYSTEM); /* start with POWER_ON */
+
     DBG("\r\nInit completed.\r\n");
 }
 
@@ -168,6 +352,7 @@ static ret_value_t light_reset(void)
 
     if((wdg->watchdog_sts == WDG_ENABLE)&&(wdg->watchdog_state == INIT))
     {
+        delay_watchdog_kick();
         wdg->watchdog_state = RUN;
         DBG("RST - WDG runs\r\n");
     }
@@ -216,6 +401,7 @@ static ret_value_t input_manager(void)
     /* manual reset button */
     if(input_state->man_res == ACTIVATED)
     {
+        trace_event(TRACE_INPUT, TRACE_INPUT_MAN_RES);
         value = GO_TO_LIGHT_RESET;
         input_state->man_res = DEACTIVATED;
     }
@@ -223,6 +409,7 @@ static ret_value_t input_manager(void)
     /* sw reset */
     if (input_state->sysres_out == ACTIVATED)
     {
+        trace_event(TRACE_INPUT, TRACE_INPUT_SYSRES_OUT);
         value = GO_TO_LIGHT_RESET;
         input_state->sysres_out = DEACTIVATED;
     }
@@ -230,7 +417,9 @@ static ret_value_t input_manager(void)
     /* PG signals from all DC/DC regulator (except of 4.5V user regulator) */
     if(input_state->pg == ACTIVATED)
     {
+        trace_event(TRACE_INPUT, TRACE_INPUT_PG);
         DBG("PG all regulators\r\n");
+        reset_cause_set_fw(RESET_FW_PG_FAULT);
         value = GO_TO_HARD_RESET;
         input_state->pg = DEACTIVATED;
     }
@@ -238,7 +427,9 @@ static ret_value_t input_manager(void)
     /* PG signal from 4.5V user controlled regulator */
     if(input_state->pg_4v5 == ACTIVATED)
     {
+        trace_event(TRACE_INPUT, TRACE_INPUT_PG_4V5);
         DBG("PG from 4V5\r\n");
+        reset_cause_set_fw(RESET_FW_PG_FAULT);
         value = GO_TO_HARD_RESET;
         input_state->pg_4v5 = DEACTIVATED;
     }
@@ -246,35 +437,35 @@ static ret_value_t input_manager(void)
     /* USB30 overcurrent */
     if(input_state->usb30_ovc == ACTIVATED)
     {
+        trace_event(TRACE_INPUT, TRACE_INPUT_USB30_OVC);
         i2c_control->status_word |= USB30_OVC_STSBIT;
         input_state->usb30_ovc = DEACTIVATED;
-        power_control_usb(USB3_PORT0, USB_OFF); /* USB power off */
 
-        if(!power_control_get_usb_poweron(USB3_PORT0))  /* update status word */
-            i2c_control->status_word &= (~USB30_PWRON_STSBIT);
+        /* USB power off, retry later */
+        power_control_usb_overcurrent(USB3_PORT0);
 
-        /* USB timeout set to 1 sec */
-        power_control_usb_timeout_enable();
+        if(!power_control_get_usb_poweron(USB3_PORT0)) /* update status word */
+            i2c_control->status_word &= (~USB30_PWRON_STSBIT);
     }
 
     /* USB31 overcurrent */
     if(input_state->usb31_ovc == ACTIVATED)
     {
+        trace_event(TRACE_INPUT, TRACE_INPUT_USB31_OVC);
         i2c_control->status_word |= USB31_OVC_STSBIT;
         input_state->usb31_ovc = DEACTIVATED;
 
-        power_control_usb(USB3_PORT1, USB_OFF); /* USB power off */
+        /* USB power off, retry later */
+        power_control_usb_overcurrent(USB3_PORT1);
 
         if(!power_control_get_usb_poweron(USB3_PORT1)) /* update status word */
             i2c_control->status_word &= (~USB31_PWRON_STSBIT);
-
-        /* USB timeout set to 1 sec */
-        power_control_usb_timeout_enable();
     }
 
     /* front button */
     if (input_state->button_sts == ACTIVATED)
     {
+        trace_event(TRACE_INPUT, TRACE_INPUT_BUTTON);
         if (button->button_mode == BUTTON_DEFAULT)
             led_step_brightness();
         else /* user button mode */
@@ -299,6 +490,12 @@ static ret_value_t input_manager(void)
         }
     }
 
+    /* button gestures are queued in user mode only */
+    if (gesture_pending())
+        i2c_control->status_word |= BUTTON_EVENT_STSBIT;
+    else
+        i2c_control->status_word &= (~BUTTON_EVENT_STSBIT);
+
     /* these flags are automatically cleared in debounce function */
     if(input_state->card_det == ACTIVATED)
         i2c_control->status_word |= CARD_DET_STSBIT;
@@ -365,6 +562,8 @@ static ret_value_t ic2_manager(void)
         case SLAVE_I2C_HARD_RST:            value = GO_TO_HARD_RESET; break;
         case SLAVE_I2C_PWR4V5_ENABLE:       value = enable_4v5(); break;
         case SLAVE_I2C_GO_TO_BOOTLOADER:    value = GO_TO_BOOTLOADER; break;
+        case SLAVE_I2C_SAVE_LED_PROFILE:    led_save_profile(); break;
+        case SLAVE_I2C_CLEAR_LED_PROFILE:   led_clear_profile(); break;
         default:                            value = OK; break;
     }
 
@@ -422,40 +621,62 @@ static void error_manager(ret_value_t error_state)
 }
 
 /*******************************************************************************
-  * @function   app_mcu_cyclic
-  * @brief      Main cyclic function.
+  * @function   app_set_system_state
+  * @brief      Change state of the board, the change is done by system task.
+  *             Other board tasks run in RUNNING state only.
+  * @param      state: new state.
+  * @retval     None.
+  *****************************************************************************/
+static void app_set_system_state(states_t state)
+{
+    FunctionalState running = (state == RUNNING) ? ENABLE : DISABLE;
+
+    system_state = state;
+    trace_event(TRACE_STATE, state);
+
+    scheduler_enable(TASK_INPUT, running);
+    scheduler_enable(TASK_I2C, running);
+    scheduler_enable(TASK_LED, running);
+    scheduler_enable(TASK_EEPROM, running);
+
+    if (state != RUNNING)
+        scheduler_trigger(TASK_SYSTEM);
+}
+
+/*******************************************************************************
+  * @function   system_task
+  * @brief      Power on, resets and errors of the board.
   * @param      None.
   * @retval     None.
   *****************************************************************************/
-void app_mcu_cyclic(void)
+static void system_task(void)
 {
-    static states_t next_state = POWER_ON;
-    static ret_value_t val = OK;
     static uint8_t error_counter;
 
-    switch(next_state)
+    switch(system_state)
     {
         case POWER_ON:
         {
-            val = power_on();
+            system_error = power_on();
 
-            if(val == OK)
-                next_state = LIGHT_RESET;
+            if(system_error == OK)
+                app_set_system_state(LIGHT_RESET);
             else
-                next_state = ERROR_STATE;
+                app_set_system_state(ERROR_STATE);
         }
         break;
 
         case LIGHT_RESET:
         {
-            val = light_reset();
+            light_reset();
 
-            next_state = LOAD_SETTINGS;
+            app_set_system_state(LOAD_SETTINGS);
         }
         break;
 
         case HARD_RESET:
         {
+            EE_Flush(0);
             NVIC_SystemReset();
         }
         break;
@@ -464,68 +685,134 @@ void app_mcu_cyclic(void)
         {
             load_settings();
 
-            next_state = INPUT_MANAGER;
+            app_set_system_state(RUNNING);
         }
         break;
 
         case ERROR_STATE:
         {
-            error_manager(val);
+            error_manager(system_error);
             error_counter++;
 
             if(error_counter >= MAX_ERROR_COUNT)
             {
-                next_state = HARD_RESET;
+                reset_cause_set_fw(RESET_FW_POWER_ERROR);
+                app_set_system_state(HARD_RESET);
                 error_counter = 0;
             }
             else
             {
-                next_state = ERROR_STATE;
+                app_set_system_state(ERROR_STATE);
             }
         }
         break;
 
-        case INPUT_MANAGER:
-        {
-            val = input_manager();
-
-            switch(val)
-            {
-                case GO_TO_LIGHT_RESET: next_state = LIGHT_RESET; break;
-                case GO_TO_HARD_RESET: next_state = HARD_RESET; break;
-                default: next_state = I2C_MANAGER; break;
-            }
-        }
+        case RUNNING:
         break;
 
-        case I2C_MANAGER:
+        case BOOTLOADER:
         {
-            val = ic2_manager();
+            /* the request for bootloader is written here */
+            EE_Flush(0);
+            start_bootloader();
+        } break;
+    }
+}
 
-            switch(val)
-            {
-                case GO_TO_LIGHT_RESET: next_state = LIGHT_RESET; break;
-                case GO_TO_HARD_RESET:  next_state = HARD_RESET; break;
-                case GO_TO_4V5_ERROR:   next_state = ERROR_STATE; break;
-                case GO_TO_BOOTLOADER:  next_state = BOOTLOADER; break;
-                default: next_state = LED_MANAGER; break;
-            }
-        }
-        break;
+/*******************************************************************************
+  * @function   input_task
+  * @brief      Evaluate input signals, every 5 ms and on input events.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+static void input_task(void)
+{
+    switch(input_manager())
+    {
+        case GO_TO_LIGHT_RESET: app_set_system_state(LIGHT_RESET); break;
+        case GO_TO_HARD_RESET: app_set_system_state(HARD_RESET); break;
+        default: break;
+    }
+}
 
-        case LED_MANAGER:
-        {
-            if (effect_reset_finished == SET)
-            {
-                led_manager();
-            }
-            next_state = INPUT_MANAGER;
-        }
-        break;
+/*******************************************************************************
+  * @function   i2c_task
+  * @brief      Handle requests from I2C, every 5 ms and after I2C transfer.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+static void i2c_task(void)
+{
+    ret_value_t val = ic2_manager();
 
-        case BOOTLOADER:
+    switch(val)
+    {
+        case GO_TO_LIGHT_RESET: app_set_system_state(LIGHT_RESET); break;
+        case GO_TO_HARD_RESET:
         {
-            start_bootloader();
+            reset_cause_set_fw(RESET_FW_I2C);
+            app_set_system_state(HARD_RESET);
+        } break;
+        case GO_TO_BOOTLOADER:  app_set_system_state(BOOTLOADER); break;
+        case GO_TO_4V5_ERROR:
+        {
+            system_error = val;
+            app_set_system_state(ERROR_STATE);
         } break;
+        default: break;
+    }
+}
+
+/*******************************************************************************
+  * @function   led_task
+  * @brief      System LED activity, every 10 ms.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+static void led_task(void)
+{
+    led_finish_reset_effect();
+
+    if (effect_reset_finished == SET)
+    {
+        led_manager();
     }
 }
+
+/*******************************************************************************
+  * @function   eeprom_task
+  * @brief      Write deferred settings after a quiet period and erase used
+  *             EEPROM emulation pages in advance, every 100 ms. Flash
+  *             operations stall the CPU, so it runs in RUNNING state only.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+static void eeprom_task(void)
+{
+    uint16_t status = EE_Flush(EEPROM_QUIET_PERIOD);
+
+    if (status != FLASH_COMPLETE)
+        DBG("EEPROM flush failed %d\r\n", status);
+
+    status = EE_Maintenance();
+
+    if ((status != FLASH_COMPLETE) && (status != NO_VALID_PAGE))
+        DBG("EEPROM maintenance failed %d\r\n", status);
+}
+
+/*******************************************************************************
+  * @function   app_mcu_cyclic
+  * @brief      Main cyclic function. Sleeps until some work is posted and
+  *             runs the scheduler.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+void app_mcu_cyclic(void)
+{
+    uint8_t events;
+
+    delay_iwdg_reload();
+
+    events = app_wait_for_event();
+    scheduler_run(events);
+}
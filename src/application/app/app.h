@@ -33,12 +33,35 @@ typedef enum {
     HARD_RESET,
     LOAD_SETTINGS,
     ERROR_STATE,
-    INPUT_MANAGER,
-    I2C_MANAGER,
-    LED_MANAGER,
+    RUNNING,
     BOOTLOADER
 } states_t;
 
+/* sources of work for the main loop, posted from interrupts */
+typedef enum {
+    APP_EVENT_TICK       = 0x01, /* SysTick */
+    APP_EVENT_I2C        = 0x02, /* I2C transfer */
+    APP_EVENT_INPUT      = 0x04, /* input signal edge, debounce, USB timeout */
+    APP_EVENT_LED        = 0x08, /* LED effect step */
+    APP_EVENT_TASK       = 0x10, /* scheduler task triggered */
+} app_event_t;
+
+/*******************************************************************************
+  * @function   app_post_event
+  * @brief      Wake up the main loop. Can be called from any interrupt.
+  * @param      event: source of the work.
+  * @retval     None.
+  *****************************************************************************/
+void app_post_event(app_event_t event);
+
+/*******************************************************************************
+  * @function   app_get_cpu_load
+  * @brief      CPU duty cycle of the main loop measured over the last second.
+  * @param      None.
+  * @retval     Busy time in 0.1 % units (0 - 1000).
+  *****************************************************************************/
+uint16_t app_get_cpu_load(void);
+
 /*******************************************************************************
   * @function   app_mcu_init
   * @brief      Initialization of MCU and its ports and peripherals.
@@ -49,7 +72,8 @@ void app_mcu_init(void);
 
 /*******************************************************************************
   * @function   app_mcu_cyclic
-  * @brief      Main cyclic function.
+  * @brief      Main cyclic function. Sleeps until some work is posted and
+  *             runs the scheduler.
   * @param      None.
   * @retval     None.
   *****************************************************************************/
@@ -0,0 +1,68 @@
+/**
+ ******************************************************************************
+ * @file    crash.c
+ * @author  CZ.NIC, z.s.p.o.
+ * @date    18-October-2026
+ * @brief   Record of a HardFault kept in uninitialized RAM over the reset,
+ *          so it can be read by the main CPU after the restart.
+ ******************************************************************************
+ ******************************************************************************
+ **/
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f0xx.h"
+#include "crash.h"
+#include "reset_cause.h"
+
+#define CRASH_INFO_MAGIC            0xC4A5B10C
+
+/* stacked registers in the exception frame */
+#define FRAME_LR                    5
+#define FRAME_PC                    6
+#define FRAME_XPSR                  7
+#define FRAME_SIZE                  8
+
+static struct st_crash_info crash_info __attribute__((section(".noinit.crash")));
+
+/*******************************************************************************
+  * @function   crash_save
+  * @brief      Save the fault record and reset the MCU. Called from
+  *             HardFault_Handler.
+  * @param      frame: exception stack frame (r0-r3, r12, lr, pc, xpsr).
+  * @retval     None.
+  *****************************************************************************/
+void crash_save(const uint32_t *frame)
+{
+    struct st_crash_info *crash = &crash_info;
+
+    if (crash->magic != CRASH_INFO_MAGIC)
+        crash->count = 0;
+
+    crash->pc = frame[FRAME_PC];
+    crash->lr = frame[FRAME_LR];
+    crash->xpsr = frame[FRAME_XPSR];
+    crash->icsr = SCB->ICSR;
+    crash->sp = (uint32_t)(frame + FRAME_SIZE);
+    crash->reason = CRASH_HARD_FAULT;
+
+    if (crash->count < 0xFF)
+        crash->count++;
+
+    crash->magic = CRASH_INFO_MAGIC;
+
+    reset_cause_set_fw(RESET_FW_HARD_FAULT);
+    NVIC_SystemReset();
+}
+
+/*******************************************************************************
+  * @function   crash_get_info
+  * @brief      Access to the record of the last crash.
+  * @param      None.
+  * @retval     Crash record or 0 if there was no crash since power-up.
+  *****************************************************************************/
+const struct st_crash_info *crash_get_info(void)
+{
+    if (crash_info.magic != CRASH_INFO_MAGIC)
+        return 0;
+
+    return &crash_info;
+}
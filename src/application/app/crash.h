@@ -0,0 +1,47 @@
+/**
+ ******************************************************************************
+ * @file    crash.h
+ * @author  CZ.NIC, z.s.p.o.
+ * @date    18-October-2026
+ * @brief   Header file for crash.c
+ ******************************************************************************
+ ******************************************************************************
+ **/
+#ifndef CRASH_H
+#define CRASH_H
+
+typedef enum crash_reasons {
+    CRASH_NONE              = 0,
+    CRASH_HARD_FAULT        = 1,
+} crash_reason_t;
+
+/* record of the last crash, kept in RAM over the reset */
+struct st_crash_info {
+    uint32_t magic;             /* CRASH_INFO_MAGIC - record is valid */
+    uint32_t pc;                /* stacked registers of the fault */
+    uint32_t lr;
+    uint32_t xpsr;
+    uint32_t icsr;              /* SCB->ICSR (M0 has no fault status regs) */
+    uint32_t sp;                /* stack pointer before the fault */
+    uint8_t reason;             /* crash_reason_t */
+    uint8_t count;              /* crashes since power-up */
+};
+
+/*******************************************************************************
+  * @function   crash_save
+  * @brief      Save the fault record and reset the MCU. Called from
+  *             HardFault_Handler.
+  * @param      frame: exception stack frame (r0-r3, r12, lr, pc, xpsr).
+  * @retval     None.
+  *****************************************************************************/
+void crash_save(const uint32_t *frame);
+
+/*******************************************************************************
+  * @function   crash_get_info
+  * @brief      Access to the record of the last crash.
+  * @param      None.
+  * @retval     Crash record or 0 if there was no crash since power-up.
+  *****************************************************************************/
+const struct st_crash_info *crash_get_info(void);
+
+#endif /* CRASH_H */
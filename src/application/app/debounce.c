@@ -17,169 +17,271 @@
 #include "msata_pci.h"
 #include "debug_serial.h"
 #include "slave_i2c_device.h"
+#include "gesture.h"
+#include "sw_timer.h"
+#include "app.h"
 
-enum input_mask {
-    MAN_RES_MASK                    = 0x0001,
-    SYSRES_OUT_MASK                 = 0x0002,
-    DBG_RES_MASK                    = 0x0004,
-    MRES_MASK                       = 0x0008,
-    PG_5V_MASK                      = 0x0010,
-    PG_3V3_MASK                     = 0x0020,
-    PG_1V35_MASK                    = 0x0040,
-    PG_4V5_MASK                     = 0x0080,
-    PG_1V8_MASK                     = 0x0100,
-    PG_1V5_MASK                     = 0x0200,
-    PG_1V2_MASK                     = 0x0400,
-    PG_VTT_MASK                     = 0x0800,
-    USB30_OVC_MASK                  = 0x1000,
-    USB31_OVC_MASK                  = 0x2000,
-    RTC_ALARM_MASK                  = 0x4000,
-    BUTTON_MASK                     = 0x8000,
-};
-
-#define MAX_CARD_DET_STATES         5
-#define MAX_MSATA_IND_STATES        5
+/* inputs with immediate reaction on a falling edge (active low signals) */
+#define INPUT_EVENT_LINES           (MAN_RES_MASK | SYSRES_OUT_MASK)
 
+/* active low inputs evaluated after debounce */
+#define INPUT_FILTERED_LINES        (PG_5V_MASK | PG_3V3_MASK | PG_1V35_MASK | \
+                                     PG_4V5_MASK | PG_1V8_MASK | PG_1V5_MASK | \
+                                     PG_1V2_MASK | PG_VTT_MASK | \
+                                     USB30_OVC_MASK | USB31_OVC_MASK)
+
+#define PG_LINES                    (PG_5V_MASK | PG_3V3_MASK | PG_1V35_MASK | \
+                                     PG_1V8_MASK | PG_1V5_MASK | PG_1V2_MASK | \
+                                     PG_VTT_MASK)
+
+/* lines with counting of pulses shorter than debounce */
+#define GLITCH_LINES                (PG_LINES | PG_4V5_MASK)
+#define GLITCH_FIRST_LINE           4 /* PG_5V */
+
+#define DEBOUNCED_LINES             0x3FFFF /* port B + card detection */
+
+/* debounce depth of input lines, number of 5ms samples (1 - 7) */
+#define DEFAULT_DEPTH               2
+#define BUTTON_DEPTH                3
+#define CARD_DET_DEPTH              5
+#define MSATA_IND_DEPTH             5
 
 struct input_sig debounce_input_signal;
 struct button_def button_front;
 
-#define  DEBOUNCE_TIM_PERIODE       (300 - 1)//300 -> 5ms; 600 -> 10ms
-#define  DEBOUNCE_TIM_PRESCALER     (800 - 1)
+/* falling edges captured by EXTI and not evaluated yet */
+static volatile uint16_t input_events;
+/* event lines found in active (low) state during the last evaluation */
+static uint16_t input_held;
+
+/* Vertical counters - bit n of each plane belongs to input line n, so all
+ * lines are debounced at once by a few logic operations on whole words.
+ * Lines are active high here (port B inputs are inverted). */
+static uint32_t vcnt0, vcnt1, vcnt2;    /* samples different from the state */
+static uint32_t depth0, depth1, depth2; /* debounce depth of each line */
+static uint32_t debounced_state;        /* 1 - line is active */
+/* lines activated by debouncer and not evaluated yet */
+static volatile uint32_t debounced_events;
+/* falling edges of glitch lines captured by EXTI since the last sample */
+static volatile uint16_t glitch_edges;
+
+struct st_pg_glitches pg_glitches;
+
+#define DEBOUNCE_PERIOD             5 /* ms */
+
+static struct sw_timer debounce_timer;
+
+/*******************************************************************************
+  * @function   debounce_follow_mres
+  * @brief      RES_RAM signal follows MRES signal.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+static void debounce_follow_mres(void)
+{
+    if (GPIO_ReadInputDataBit(MRES_PIN_PORT, MRES_PIN))
+        GPIO_SetBits(RES_RAM_PIN_PORT, RES_RAM_PIN);
+    else
+        GPIO_ResetBits(RES_RAM_PIN_PORT, RES_RAM_PIN);
+}
 
 /*******************************************************************************
-  * @function   debounce_timer_config
-  * @brief      Timer configuration for debouncing. Regulary interrupt every 5ms.
+  * @function   debounce_exti_config
+  * @brief      EXTI configuration for input signals on port B. Falling edges
+  *             of event lines are collected in input_events, edges of PG
+  *             lines are used for glitch detection, MRES generates
+  *             interrupt on both edges.
   * @param      None.
   * @retval     None.
   *****************************************************************************/
-static void debounce_timer_config(void)
+static void debounce_exti_config(void)
 {
-    TIM_TimeBaseInitTypeDef  TIM_TimeBaseStructure;
+    EXTI_InitTypeDef EXTI_InitStructure;
     NVIC_InitTypeDef NVIC_InitStructure;
+    uint8_t pin;
 
-    RCC_APB2PeriphClockCmd(RCC_APB2Periph_TIM16, DISABLE);
-    TIM_DeInit(DEBOUNCE_TIMER);
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_SYSCFG, ENABLE);
 
-    /* Clock enable */
-    RCC_APB2PeriphClockCmd(RCC_APB2Periph_TIM16, ENABLE);
+    for (pin = 0; pin < 16; pin++)
+    {
+        if ((INPUT_EVENT_LINES | GLITCH_LINES | MRES_MASK) & (1 << pin))
+            SYSCFG_EXTILineConfig(EXTI_PortSourceGPIOB, pin);
+    }
+
+    EXTI_InitStructure.EXTI_Line = INPUT_EVENT_LINES | GLITCH_LINES;
+    EXTI_InitStructure.EXTI_Mode = EXTI_Mode_Interrupt;
+    EXTI_InitStructure.EXTI_Trigger = EXTI_Trigger_Falling;
+    EXTI_InitStructure.EXTI_LineCmd = ENABLE;
+    EXTI_Init(&EXTI_InitStructure);
 
-    /* Time base configuration */
-    TIM_TimeBaseStructure.TIM_Period = DEBOUNCE_TIM_PERIODE;
-    TIM_TimeBaseStructure.TIM_Prescaler = DEBOUNCE_TIM_PRESCALER;
-    TIM_TimeBaseStructure.TIM_ClockDivision = 0;
-    TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
-    TIM_TimeBaseInit(DEBOUNCE_TIMER, &TIM_TimeBaseStructure);
+    EXTI_InitStructure.EXTI_Line = MRES_MASK;
+    EXTI_InitStructure.EXTI_Trigger = EXTI_Trigger_Rising_Falling;
+    EXTI_Init(&EXTI_InitStructure);
 
-    TIM_ARRPreloadConfig(DEBOUNCE_TIMER, ENABLE);
-    /* TIM Interrupts enable */
-    TIM_ITConfig(DEBOUNCE_TIMER, TIM_IT_Update, ENABLE);
+    __disable_irq();
 
-    /* TIM enable counter */
-    TIM_Cmd(DEBOUNCE_TIMER, ENABLE);
+    EXTI_ClearITPendingBit(INPUT_EVENT_LINES | GLITCH_LINES | MRES_MASK);
+    input_events = 0;
+    glitch_edges = 0;
+    /* signals which are already active are evaluated as new events */
+    input_held = ~(GPIO_ReadInputData(GPIOB)) & INPUT_EVENT_LINES;
+    debounce_follow_mres();
 
-    NVIC_InitStructure.NVIC_IRQChannel = TIM16_IRQn;
-    NVIC_InitStructure.NVIC_IRQChannelPriority = 0x03;
+    __enable_irq();
+
+    NVIC_InitStructure.NVIC_IRQChannelPriority = 0x02;
     NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_InitStructure.NVIC_IRQChannel = EXTI0_1_IRQn;
+    NVIC_Init(&NVIC_InitStructure);
+    NVIC_InitStructure.NVIC_IRQChannel = EXTI2_3_IRQn;
+    NVIC_Init(&NVIC_InitStructure);
+    NVIC_InitStructure.NVIC_IRQChannel = EXTI4_15_IRQn;
     NVIC_Init(&NVIC_InitStructure);
 }
 
 /*******************************************************************************
-  * @function   debounce_card_det
-  * @brief      Debounce of nCARD_DET input. Called in debounce timer interrupt.
+  * @function   debounce_exti_irq_handler
+  * @brief      Collect edges of input signals. Called in EXTI interrupt handlers.
   * @param      None.
   * @retval     None.
   *****************************************************************************/
-static void debounce_card_det(void)
+void debounce_exti_irq_handler(void)
 {
-    static uint16_t counter;
-    uint8_t state;
-    struct input_sig *input_state = &debounce_input_signal;
+    uint16_t edges;
 
-    state = !(msata_pci_card_detection());
+    edges = EXTI->PR & (INPUT_EVENT_LINES | GLITCH_LINES | MRES_MASK);
+    EXTI_ClearITPendingBit(edges);
 
-    if (state) /* signal released */
-    {
-        if (counter > 0)
-            counter--;
-    }
-    else /* signal falls to low */
+    if (edges & MAN_RES_MASK)
     {
-        if (counter < MAX_CARD_DET_STATES)
-            counter++;
+        /* set CFG_CTRL pin to high state ASAP */
+        GPIO_SetBits(CFG_CTRL_PIN_PORT, CFG_CTRL_PIN);
     }
 
-    if (counter == 0)
-        input_state->card_det = DEACTIVATED;
-    else
-    {
-        if(counter >= MAX_CARD_DET_STATES)
-        {
-            input_state->card_det = ACTIVATED;
-            counter = MAX_CARD_DET_STATES;
-        }
-    }
+    /* reaction: follow MRES signal */
+    if (edges & MRES_MASK)
+        debounce_follow_mres();
+
+    input_events |= edges & INPUT_EVENT_LINES;
+    glitch_edges |= edges & GLITCH_LINES;
 }
 
 /*******************************************************************************
-  * @function   debounce_msata_ind
-  * @brief      Debounce of MSATAIND input. Called in debounce timer interrupt.
+  * @function   debounce_sample_inputs
+  * @brief      Read all debounced input lines at once.
   * @param      None.
+  * @retval     Input lines, 1 - line is active.
+  *****************************************************************************/
+static uint32_t debounce_sample_inputs(void)
+{
+    uint32_t sample;
+
+    sample = ~(GPIO_ReadInputData(GPIOB)) & 0xFFFF;
+
+    if (msata_pci_card_detection())
+        sample |= CARD_DET_MASK;
+
+    if (msata_pci_type_card_detection())
+        sample |= MSATA_IND_MASK;
+
+    return sample;
+}
+
+/*******************************************************************************
+  * @function   debounce_set_depth
+  * @brief      Set number of samples needed for a change of input lines.
+  * @param      lines: mask of input lines (enum input_mask).
+  * @param      depth: number of consecutive 5ms samples (1 - 7).
   * @retval     None.
   *****************************************************************************/
-static void debounce_msata_ind(void)
+void debounce_set_depth(uint32_t lines, uint8_t depth)
 {
-    static uint16_t counter;
-    uint8_t state;
-    struct input_sig *input_state = &debounce_input_signal;
+    if (depth < 1)
+        depth = 1;
+    else if (depth > MAX_DEBOUNCE_DEPTH)
+        depth = MAX_DEBOUNCE_DEPTH;
 
-    state = !(msata_pci_type_card_detection());
+    __disable_irq();
 
-    if (state) /* signal released */
-    {
-        if (counter > 0)
-            counter--;
-    }
-    else /* signal falls to low */
-    {
-        if (counter < MAX_MSATA_IND_STATES)
-            counter++;
-    }
+    depth0 = (depth & 0x01) ? (depth0 | lines) : (depth0 & ~lines);
+    depth1 = (depth & 0x02) ? (depth1 | lines) : (depth1 & ~lines);
+    depth2 = (depth & 0x04) ? (depth2 | lines) : (depth2 & ~lines);
 
-    if (counter == 0)
-        input_state->msata_ind = DEACTIVATED;
-    else
+    __enable_irq();
+}
+
+/*******************************************************************************
+  * @function   debounce_count_glitches
+  * @brief      Update glitch statistics of PG lines.
+  * @param      lines: lines with a pulse shorter than debounce.
+  * @retval     None.
+  *****************************************************************************/
+static void debounce_count_glitches(uint32_t lines)
+{
+    struct st_pg_glitches *glitch = &pg_glitches;
+    uint8_t idx;
+
+    /* PG of the user regulator is not valid while it is disabled */
+    if (!(i2c_status.status_word & ENABLE_4V5_STSBIT))
+        lines &= ~PG_4V5_MASK;
+
+    lines = (lines & GLITCH_LINES) >> GLITCH_FIRST_LINE;
+
+    if (!lines)
+        return;
+
+    for (idx = 0; idx < PG_LINE_COUNT; idx++)
     {
-        if(counter >= MAX_MSATA_IND_STATES)
-        {
-            input_state->msata_ind = ACTIVATED;
-            counter = MAX_MSATA_IND_STATES;
-        }
+        if ((lines & (1 << idx)) && (glitch->count[idx] < 0xFFFF))
+            glitch->count[idx]++;
     }
+
+    glitch->last_glitch = delay_get_uptime();
 }
 
 /*******************************************************************************
   * @function   debounce_input_timer_handler
-  * @brief      Main debounce function. Called in timer interrupt handler.
+  * @brief      Main debounce function. Called every 5 ms from debounce timer.
   * @param      None.
   * @retval     None.
   *****************************************************************************/
 void debounce_input_timer_handler(void)
 {
-    static uint16_t idx;
-    struct button_def *button = &button_front;
+    struct input_sig *input_state = &debounce_input_signal;
+    uint32_t delta, toggle, counting, edges;
+
+    /* edges are taken before the sample, a newer edge belongs to next one */
+    __disable_irq();
+    edges = glitch_edges;
+    glitch_edges = 0;
+    __enable_irq();
+
+    /* lines which differ from the debounced state */
+    delta = debounce_sample_inputs() ^ debounced_state;
+    counting = vcnt0 | vcnt1 | vcnt2;
+
+    /* count samples of these lines, counters of other lines are cleared */
+    vcnt2 = (vcnt2 ^ (vcnt1 & vcnt0)) & delta;
+    vcnt1 = (vcnt1 ^ vcnt0) & delta;
+    vcnt0 = ~vcnt0 & delta;
+
+    /* lines with the counter equal to their depth change the state */
+    toggle = delta & ~((vcnt0 ^ depth0) | (vcnt1 ^ depth1) | (vcnt2 ^ depth2));
 
-    /* port B, pins 0-14 debounced by general function debounce_check_inputs() */
-    /* only button on PB15 is debounced here, but read the whole port */
-    button->button_pin_state[idx] = ~(GPIO_ReadInputData(GPIOB));
-    idx++;
+    vcnt0 &= ~toggle;
+    vcnt1 &= ~toggle;
+    vcnt2 &= ~toggle;
 
-    if (idx >= MAX_BUTTON_DEBOUNCE_STATE)
-        idx = 0;
+    debounced_state ^= toggle;
+    debounced_events |= toggle & debounced_state;
 
-    /* other inputs handled by general function debounce_check_inputs() */
-    debounce_card_det();
-    debounce_msata_ind();
+    /* returned back before debounce finished or not sampled at all */
+    debounce_count_glitches((counting | edges) & ~delta);
+
+    input_state->card_det = (debounced_state & CARD_DET_MASK) ? ACTIVATED : DEACTIVATED;
+    input_state->msata_ind = (debounced_state & MSATA_IND_MASK) ? ACTIVATED : DEACTIVATED;
+
+    gesture_update((debounced_state & BUTTON_MASK) != 0);
 }
 
 /*******************************************************************************
@@ -190,28 +292,33 @@ void debounce_input_timer_handler(void)
   *****************************************************************************/
 void debounce_check_inputs(void)
 {
-    uint16_t i, port_changed, button_changed;
-    static uint16_t last_button_debounce_state;
+    uint32_t events, port_changed, filtered;
     struct input_sig *input_state = &debounce_input_signal;
-    struct button_def *button = &button_front;
     struct st_i2c_status *i2c_control = &i2c_status;
 
-    /* PB0-14 ----------------------------------------------------------------
-     * No debounce is used now (we need a reaction immediately) */
+    /* MAN_RES, SYSRES_OUT ----------------------------------------------------
+     * No debounce is used (we need a reaction immediately). Edges are
+     * captured by EXTI, the port is read only while some signal is active,
+     * so an active signal is reported each time as before */
+    __disable_irq();
+    events = input_events;
+    input_events = 0;
+    filtered = debounced_events;
+    debounced_events = 0;
+    __enable_irq();
 
-    port_changed = ~(GPIO_ReadInputData(GPIOB)); /* read the whole port */
+    if (events | input_held)
+        input_held = ~(GPIO_ReadInputData(GPIOB)) & INPUT_EVENT_LINES;
 
-    /* PB15 ------------------------------------------------------------------
-     * button debounce */
-    last_button_debounce_state = button->button_debounce_state;
-    button->button_debounce_state = BUTTON_MASK;
+    /* PG, OVC and button -----------------------------------------------------
+     * Evaluated after debounce, PG and OVC are reported while active */
+    filtered |= debounced_state & INPUT_FILTERED_LINES;
 
-    for (i = 0; i < MAX_BUTTON_DEBOUNCE_STATE; i++)
-    {
-        button->button_debounce_state = button->button_debounce_state & button->button_pin_state[i];
-    }
+    /* PG of the user regulator is not valid while it is disabled */
+    if (!(i2c_control->status_word & ENABLE_4V5_STSBIT))
+        filtered &= ~PG_4V5_MASK;
 
-    button_changed = (button->button_debounce_state ^ last_button_debounce_state) & button->button_debounce_state;
+    port_changed = events | input_held | filtered;
 
     /* results evaluation --------------------------------------------------- */
     if (port_changed & MAN_RES_MASK)
@@ -226,34 +333,17 @@ void debounce_check_inputs(void)
         input_state->sysres_out = ACTIVATED;
     }
 
-    if (port_changed & DBG_RES_MASK)
-    {
-        /* no reaction necessary */
-    }
-
-    /* reaction: follow MRES signal */
-    if (port_changed & MRES_MASK)
-    {
-        GPIO_ResetBits(RES_RAM_PIN_PORT, RES_RAM_PIN);
-    }
-    else
-    {
-        GPIO_SetBits(RES_RAM_PIN_PORT, RES_RAM_PIN);
-    }
+    /* MRES signal is followed in debounce_exti_irq_handler() */
 
-    if ((port_changed & PG_5V_MASK) || (port_changed & PG_3V3_MASK) ||
-         (port_changed & PG_1V35_MASK) || (port_changed & PG_VTT_MASK) ||
-         (port_changed & PG_1V8_MASK) || (port_changed & PG_1V5_MASK) ||
-         (port_changed & PG_1V2_MASK))
+    if (port_changed & PG_LINES)
     {
         input_state->pg = ACTIVATED;
     }
 
     /* PG signal from 4.5V user controlled regulator */
-    if(i2c_control->status_word & ENABLE_4V5_STSBIT)
+    if (port_changed & PG_4V5_MASK)
     {
-        if (port_changed & PG_4V5_MASK)
-            input_state->pg_4v5 = ACTIVATED;
+        input_state->pg_4v5 = ACTIVATED;
     }
 
     if (port_changed & USB30_OVC_MASK)
@@ -266,18 +356,24 @@ void debounce_check_inputs(void)
         input_state->usb31_ovc = ACTIVATED;
     }
 
-
-    if (port_changed & RTC_ALARM_MASK)
-    {
-        /* no reaction necessary */
-    }
-
-    if (button_changed & BUTTON_MASK)
+    if (port_changed & BUTTON_MASK)
     {
         input_state->button_sts = ACTIVATED;
     }
 }
 
+/*******************************************************************************
+  * @function   debounce_timer_handler
+  * @brief      Debounce timer callback, runs every DEBOUNCE_PERIOD.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+static void debounce_timer_handler(void)
+{
+    debounce_input_timer_handler();
+    app_post_event(APP_EVENT_INPUT);
+}
+
 /*******************************************************************************
   * @function   debounce_config
   * @brief      Debouncer configuration.
@@ -288,7 +384,19 @@ void debounce_config(void)
 {
     struct button_def *button = &button_front;
 
-    debounce_timer_config();
+    debounce_set_depth(DEBOUNCED_LINES, DEFAULT_DEPTH);
+    debounce_set_depth(BUTTON_MASK, BUTTON_DEPTH);
+    debounce_set_depth(CARD_DET_MASK, CARD_DET_DEPTH);
+    debounce_set_depth(MSATA_IND_MASK, MSATA_IND_DEPTH);
+
+    /* signals which are already active are evaluated without debounce */
+    debounced_state = debounce_sample_inputs();
+    vcnt0 = vcnt1 = vcnt2 = 0;
+    debounced_events = 0;
+
+    sw_timer_init(&debounce_timer, debounce_timer_handler);
+    sw_timer_start(&debounce_timer, DEBOUNCE_PERIOD, DEBOUNCE_PERIOD);
+    debounce_exti_config();
     button->button_mode = BUTTON_DEFAULT; /* default = brightness settings */
 }
 
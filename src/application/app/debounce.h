@@ -10,9 +10,8 @@
 #ifndef __DEBOUNCE_H
 #define __DEBOUNCE_H
 
-#define DEBOUNCE_TIMER                  TIM16
 #define MAX_BUTTON_PRESSED_COUNTER      7
-#define MAX_BUTTON_DEBOUNCE_STATE       3
+#define MAX_DEBOUNCE_DEPTH              7
 
 typedef enum button_modes {
     BUTTON_DEFAULT,
@@ -24,6 +23,28 @@ typedef enum button_states {
     BUTTON_RELEASED,
 }button_state_t;
 
+/* debounced input lines: port B pins and card detection signals */
+enum input_mask {
+    MAN_RES_MASK                    = 0x0001,
+    SYSRES_OUT_MASK                 = 0x0002,
+    DBG_RES_MASK                    = 0x0004,
+    MRES_MASK                       = 0x0008,
+    PG_5V_MASK                      = 0x0010,
+    PG_3V3_MASK                     = 0x0020,
+    PG_1V35_MASK                    = 0x0040,
+    PG_4V5_MASK                     = 0x0080,
+    PG_1V8_MASK                     = 0x0100,
+    PG_1V5_MASK                     = 0x0200,
+    PG_1V2_MASK                     = 0x0400,
+    PG_VTT_MASK                     = 0x0800,
+    USB30_OVC_MASK                  = 0x1000,
+    USB31_OVC_MASK                  = 0x2000,
+    RTC_ALARM_MASK                  = 0x4000,
+    BUTTON_MASK                     = 0x8000,
+    CARD_DET_MASK                   = 0x10000,
+    MSATA_IND_MASK                  = 0x20000,
+};
+
 enum input_states {
     DEACTIVATED = 0,
     ACTIVATED = 1, /* when signal reaches a defined treshold */
@@ -49,10 +70,18 @@ struct button_def {
     button_mode_t button_mode;
     button_state_t button_state;
     int8_t button_pressed_counter;
-    uint16_t button_pin_state[MAX_BUTTON_DEBOUNCE_STATE];
-    uint16_t button_debounce_state;
 };
 
+#define PG_LINE_COUNT                   8
+
+/* pulses on PG lines shorter than debounce, in order of port B pins:
+ * 5V, 3V3, 1V35, 4V5, 1V8, 1V5, 1V2, VTT */
+struct st_pg_glitches {
+    uint16_t count[PG_LINE_COUNT];      /* saturated at 0xFFFF */
+    uint32_t last_glitch;               /* MCU uptime of the last glitch [ms] */
+};
+
+extern struct st_pg_glitches pg_glitches;
 extern struct input_sig debounce_input_signal;
 extern struct button_def button_front;
 
@@ -66,12 +95,29 @@ void debounce_config(void);
 
 /*******************************************************************************
   * @function   debounce_input_timer_handler
-  * @brief      Main debounce function. Called in timer interrupt handler.
+  * @brief      Main debounce function. Called every 5 ms from debounce timer.
   * @param      None.
   * @retval     None.
   *****************************************************************************/
 void debounce_input_timer_handler(void);
 
+/*******************************************************************************
+  * @function   debounce_set_depth
+  * @brief      Set number of samples needed for a change of input lines.
+  * @param      lines: mask of input lines (enum input_mask).
+  * @param      depth: number of consecutive 5ms samples (1 - 7).
+  * @retval     None.
+  *****************************************************************************/
+void debounce_set_depth(uint32_t lines, uint8_t depth);
+
+/*******************************************************************************
+  * @function   debounce_exti_irq_handler
+  * @brief      Collect edges of input signals. Called in EXTI interrupt handlers.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+void debounce_exti_irq_handler(void);
+
 /*******************************************************************************
   * @function   debounce_check_inputs
   * @brief      Check input signal.
@@ -3,20 +3,77 @@
  * @file    debug_serial.c
  * @author  CZ.NIC, z.s.p.o.
  * @date    25-August-2015
- * @brief   Debug prints on serial port.
+ * @brief   Debug prints on serial port. Only message ID and raw arguments
+ *          are put into a ring buffer and sent by DMA, so the caller (even an
+ *          interrupt) is never blocked by the serial port. Format strings are
+ *          kept in a not loaded ELF section and the stream is decoded by
+ *          tools/dbg_decode.py.
  ******************************************************************************
  ******************************************************************************
  **/
+#include <stdarg.h>
 #include "stm32f0xx_conf.h"
 #include "debug_serial.h"
 
 #define SERIAL_PORT      USART1
+#define SERIAL_DMA       DMA1_Channel2 /* USART1_TX */
+#define SERIAL_DMA_IT_TC DMA1_IT_TC2
+
+#define LOG_BUFFER_SIZE  512 /* power of 2 */
+#define LOG_INDEX(idx)   ((idx) & (LOG_BUFFER_SIZE - 1))
+#define LOG_SYNC         0xA5
+#define LOG_FRAME_SIZE(nargs) (4 + 4 * (nargs))
 
 #if DBG_ENABLE
 
+struct st_log {
+    char buf[LOG_BUFFER_SIZE];
+    volatile uint16_t head;         /* free running write index */
+    volatile uint16_t tail;         /* free running index of unsent data */
+    volatile uint16_t dma_len;      /* length of the running transfer */
+    volatile uint16_t dropped;      /* messages not fitting into the buffer */
+    uint16_t lost;                  /* dropped since the last sent message */
+    uint8_t ready;                  /* serial port is configured */
+};
+
+static struct st_log dbg_log;
+
+/*******************************************************************************
+  * @function   debug_dma_kick
+  * @brief      Start sending of the next contiguous block of the buffer, if
+  *             DMA is idle. Interrupts must be disabled.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+static void debug_dma_kick(void)
+{
+    struct st_log *log_buf = &dbg_log;
+    uint16_t len, tail;
+
+    if (!log_buf->ready || log_buf->dma_len)
+        return;
+
+    len = log_buf->head - log_buf->tail;
+    if (len == 0)
+        return;
+
+    tail = LOG_INDEX(log_buf->tail);
+
+    /* stop at the end of the buffer, the rest goes in the next transfer */
+    if (len > LOG_BUFFER_SIZE - tail)
+        len = LOG_BUFFER_SIZE - tail;
+
+    log_buf->dma_len = len;
+
+    DMA_Cmd(SERIAL_DMA, DISABLE);
+    SERIAL_DMA->CMAR = (uint32_t)&log_buf->buf[tail];
+    DMA_SetCurrDataCounter(SERIAL_DMA, len);
+    DMA_Cmd(SERIAL_DMA, ENABLE);
+}
+
 /*******************************************************************************
   * @function   debug_serial_config
-  * @brief      Configuration of UART peripheral.
+  * @brief      Configuration of UART peripheral and its TX DMA channel.
   * @param      None.
   * @retval     None.
   *****************************************************************************/
@@ -24,11 +81,14 @@ void debug_serial_config(void)
 {
     USART_InitTypeDef USART_InitStructure;
     GPIO_InitTypeDef GPIO_InitStructure;
+    DMA_InitTypeDef DMA_InitStructure;
+    NVIC_InitTypeDef NVIC_InitStructure;
 
     RCC_APB2PeriphClockCmd(RCC_APB2Periph_USART1, DISABLE);
     USART_DeInit(SERIAL_PORT);
 
     RCC_AHBPeriphClockCmd(RCC_AHBPeriph_GPIOA, ENABLE);
+    RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1, ENABLE);
 
     RCC_APB2PeriphClockCmd(RCC_APB2Periph_USART1, ENABLE);
 
@@ -50,26 +110,188 @@ void debug_serial_config(void)
     USART_InitStructure.USART_Mode = USART_Mode_Rx | USART_Mode_Tx;
     USART_Init(SERIAL_PORT, &USART_InitStructure);
 
+    /* memory address and length are set for each transfer */
+    DMA_DeInit(SERIAL_DMA);
+    DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&SERIAL_PORT->TDR;
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)dbg_log.buf;
+    DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralDST;
+    DMA_InitStructure.DMA_BufferSize = 1;
+    DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+    DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+    DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+    DMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
+    DMA_InitStructure.DMA_Priority = DMA_Priority_Low;
+    DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+    DMA_Init(SERIAL_DMA, &DMA_InitStructure);
+    DMA_ITConfig(SERIAL_DMA, DMA_IT_TC, ENABLE);
+
+    /* the lowest priority - sending is never urgent */
+    NVIC_InitStructure.NVIC_IRQChannel = DMA1_Channel2_3_IRQn;
+    NVIC_InitStructure.NVIC_IRQChannelPriority = 5;
+    NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&NVIC_InitStructure);
+
+    USART_DMACmd(SERIAL_PORT, USART_DMAReq_Tx, ENABLE);
     USART_Cmd(SERIAL_PORT, ENABLE);
+
+    /* send messages logged before the configuration */
+    __disable_irq();
+    dbg_log.ready = 1;
+    dbg_log.dma_len = 0;
+    debug_dma_kick();
+    __enable_irq();
+}
+
+/*******************************************************************************
+  * @function   debug_serial_dma_handler
+  * @brief      Release the sent block and start the next one. Called from
+  *             DMA1 Channel 2 and 3 interrupt.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+void debug_serial_dma_handler(void)
+{
+    struct st_log *log_buf = &dbg_log;
+
+    if (DMA_GetITStatus(SERIAL_DMA_IT_TC) == RESET)
+        return;
+
+    DMA_ClearITPendingBit(SERIAL_DMA_IT_TC);
+
+    log_buf->tail += log_buf->dma_len;
+    log_buf->dma_len = 0;
+
+    debug_dma_kick();
+}
+
+/*******************************************************************************
+  * @function   debug_put_frame
+  * @brief      Copy the frame to the buffer. Interrupts must be disabled and
+  *             there must be enough free space.
+  * @param      frame: frame to be copied.
+  * @param      len: length of the frame.
+  * @retval     None.
+  *****************************************************************************/
+static void debug_put_frame(const uint8_t *frame, uint16_t len)
+{
+    struct st_log *log_buf = &dbg_log;
+    uint16_t idx;
+
+    for (idx = 0; idx < len; idx++)
+        log_buf->buf[LOG_INDEX(log_buf->head + idx)] = frame[idx];
+
+    log_buf->head += len;
 }
 
 /*******************************************************************************
-  * @function   debug_print
-  * @brief      Send data over the serial port.
-  * @param      buffer: pointer to data buffer.
+  * @function   debug_build_frame
+  * @brief      Build the log frame: sync byte, number of arguments, message ID
+  *             and the arguments, all little endian.
+  * @param      frame: output buffer, at least LOG_FRAME_SIZE(nargs) bytes.
+  * @param      id: message ID.
+  * @param      nargs: number of arguments.
+  * @param      args: arguments.
+  * @retval     Length of the frame.
+  *****************************************************************************/
+static uint16_t debug_build_frame(uint8_t *frame, uint16_t id, uint8_t nargs,
+                                  va_list args)
+{
+    uint16_t len = 0;
+    uint32_t arg;
+
+    frame[len++] = LOG_SYNC;
+    frame[len++] = nargs;
+    frame[len++] = id & 0xFF;
+    frame[len++] = id >> 8;
+
+    while (nargs--)
+    {
+        arg = va_arg(args, uint32_t);
+        frame[len++] = arg & 0xFF;
+        frame[len++] = (arg >> 8) & 0xFF;
+        frame[len++] = (arg >> 16) & 0xFF;
+        frame[len++] = arg >> 24;
+    }
+
+    return len;
+}
+
+/*******************************************************************************
+  * @function   debug_log
+  * @brief      Queue the message ID with raw arguments for sending. Format
+  *             strings are not in the flash, they are decoded by the host.
+  *             The whole message is dropped if it does not fit into the
+  *             buffer, the number of dropped messages is sent before the next
+  *             message.
+  * @param      id: message ID (address of the format in .dbg_fmt section).
+  * @param      nargs: number of arguments, at most DBG_MAX_ARGS.
+  * @param      ...: uint32_t arguments.
   * @retval     None.
   *****************************************************************************/
-void debug_print(const char *buffer)
+void debug_log(uint16_t id, uint8_t nargs, ...)
 {
-    while (*buffer)
+    struct st_log *log_buf = &dbg_log;
+    uint8_t frame[LOG_FRAME_SIZE(DBG_MAX_ARGS)];
+    uint8_t drop_frame[LOG_FRAME_SIZE(1)];
+    uint16_t len, drop_len = 0, free_space;
+    uint32_t primask;
+    va_list args;
+
+    if (nargs > DBG_MAX_ARGS)
+        nargs = DBG_MAX_ARGS;
+
+    va_start(args, nargs);
+    len = debug_build_frame(frame, id, nargs, args);
+    va_end(args);
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (log_buf->lost)
+    {
+        drop_frame[0] = LOG_SYNC;
+        drop_frame[1] = 1;
+        drop_frame[2] = DBG_ID_DROPPED & 0xFF;
+        drop_frame[3] = DBG_ID_DROPPED >> 8;
+        drop_frame[4] = log_buf->lost & 0xFF;
+        drop_frame[5] = log_buf->lost >> 8;
+        drop_frame[6] = 0;
+        drop_frame[7] = 0;
+        drop_len = sizeof(drop_frame);
+    }
+
+    free_space = LOG_BUFFER_SIZE - (uint16_t)(log_buf->head - log_buf->tail);
+
+    if (len + drop_len > free_space)
+    {
+        log_buf->lost++;
+        log_buf->dropped++;
+    }
+    else
     {
-        /* Loop until the end of transmission */
-        while (USART_GetFlagStatus(SERIAL_PORT, USART_FLAG_TXE) == RESET)
-            ;
-        USART_SendData(SERIAL_PORT, *buffer++);
+        if (drop_len)
+        {
+            debug_put_frame(drop_frame, drop_len);
+            log_buf->lost = 0;
+        }
+
+        debug_put_frame(frame, len);
+        debug_dma_kick();
     }
-    while (USART_GetFlagStatus(SERIAL_PORT, USART_FLAG_TC) == RESET)
-        ;
+
+    __set_PRIMASK(primask);
+}
+
+/*******************************************************************************
+  * @function   debug_get_dropped
+  * @brief      Number of messages dropped because of full buffer.
+  * @param      None.
+  * @retval     Dropped messages since start.
+  *****************************************************************************/
+uint16_t debug_get_dropped(void)
+{
+    return dbg_log.dropped;
 }
 
 #endif
@@ -17,19 +17,39 @@
 
 /*******************************************************************************
   * @function   debug_serial_config
-  * @brief      Configuration of UART peripheral.
+  * @brief      Configuration of UART peripheral and its TX DMA channel.
   * @param      None.
   * @retval     None.
   *****************************************************************************/
 void debug_serial_config(void);
 
 /*******************************************************************************
-  * @function   debug_print
-  * @brief      Send buffer over the serial port.
-  * @param      buffer: pointer to data buffer.
+  * @function   debug_serial_dma_handler
+  * @brief      Release the sent block and start the next one. Called from
+  *             DMA1 Channel 2 and 3 interrupt.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+void debug_serial_dma_handler(void);
+
+/*******************************************************************************
+  * @function   debug_log
+  * @brief      Queue the message ID with raw arguments for sending. The whole
+  *             message is dropped if it does not fit into the buffer.
+  * @param      id: message ID (address of the format in .dbg_fmt section).
+  * @param      nargs: number of arguments, at most DBG_MAX_ARGS.
+  * @param      ...: uint32_t arguments.
   * @retval     None.
   *****************************************************************************/
-void debug_print(const char *buffer);
+void debug_log(uint16_t id, uint8_t nargs, ...);
+
+/*******************************************************************************
+  * @function   debug_get_dropped
+  * @brief      Number of messages dropped because of full buffer.
+  * @param      None.
+  * @retval     Dropped messages since start.
+  *****************************************************************************/
+uint16_t debug_get_dropped(void);
 
 #else /* !DBG_ENABLE */
 
@@ -37,17 +57,47 @@ static inline void debug_serial_config(void)
 {
 }
 
-static inline void debug_print(const char *buffer)
+static inline void debug_serial_dma_handler(void)
 {
-	(void)buffer;
 }
 
-#endif /* !DBG_ENABLE */
+static inline void debug_log(uint16_t id, uint8_t nargs, ...)
+{
+	(void)id;
+	(void)nargs;
+}
 
-static inline void DBG(const char *buf)
+static inline uint16_t debug_get_dropped(void)
 {
-	return debug_print(buf);
+	return 0;
 }
 
-#endif // DEBUG_SERIAL_H
+#endif /* !DBG_ENABLE */
+
+#define DBG_MAX_ARGS    6
+/* ID of the message with number of dropped messages */
+#define DBG_ID_DROPPED  0xFFFF
 
+#define DBG_NARGS(...)  DBG_NARGS_(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define DBG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, n, ...) n
+
+/*
+ * Log a message, it never blocks and may be called from interrupts.
+ * The format string stays in .dbg_fmt section, which is not loaded to the
+ * flash, and its address is the message ID. Arguments are sent as raw 32 bit
+ * values, supported conversions are %d, %u, %x (with width) and %c.
+ */
+#if DBG_ENABLE
+#define DBG(fmt, ...) \
+    do { \
+        static const char dbg_fmt[] __attribute__((section(".dbg_fmt"))) = fmt; \
+        _Static_assert(DBG_NARGS(__VA_ARGS__) <= DBG_MAX_ARGS, \
+                       "too many DBG arguments"); \
+        debug_log((uint16_t)(uint32_t)dbg_fmt, DBG_NARGS(__VA_ARGS__), \
+                  ##__VA_ARGS__); \
+    } while (0)
+#else
+#define DBG(fmt, ...)   debug_log(0, 0, ##__VA_ARGS__)
+#endif
+
+#endif // DEBUG_SERIAL_H
@@ -8,14 +8,23 @@
  ******************************************************************************
  **/
 /* Includes ------------------------------------------------------------------*/
-#include "stm32f0xx.h"
+#include "stm32f0xx_conf.h"
 #include "delay.h"
 #include "power_control.h"
+#include "reset_cause.h"
+#include "eeprom.h"
 
 #define WATCHDOG_ENABLE     1
-#define WATCHDOG_TIMEOUT    120000 /* ms */
+
+/* independent watchdog: LSI (~40 kHz) / 64 = 625 Hz, 2500 ticks = 4 s */
+#define IWDG_PRESCALER      IWDG_Prescaler_64
+#define IWDG_RELOAD         2500
 
 static volatile uint32_t timingdelay;
+static volatile uint32_t uptime;
+static volatile uint32_t wdg_elapsed; /* ms since the watchdog was kicked */
+static volatile uint8_t wdg_expired;
+static uint8_t iwdg_running;
 
 struct st_watchdog watchdog;
 
@@ -46,7 +55,114 @@ void delay(volatile uint32_t nTime)
 {
     timingdelay = nTime;
 
-    while(timingdelay != 0u);
+    /* sleep, SysTick wakes us up every ms */
+    while(timingdelay != 0u)
+    {
+        __WFI();
+    }
+}
+
+/******************************************************************************
+  * @function   delay_iwdg_config
+  * @brief      Start the independent watchdog. It can not be stopped until
+  *             the next reset, so it is started only if the bootloader
+  *             reloads it too (older bootloaders would be reset during
+  *             firmware update).
+  * @param      None
+  * @retval     None
+  *****************************************************************************/
+void delay_iwdg_config(void)
+{
+    if (!BOOT_HAS_FEATURE(BOOT_FEATURE_IWDG))
+        return;
+
+    /* keep the watchdog frozen while the core is halted by debugger */
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_DBGMCU, ENABLE);
+    DBGMCU_APB1PeriphConfig(DBGMCU_IWDG_STOP, ENABLE);
+
+    IWDG_WriteAccessCmd(IWDG_WriteAccess_Enable);
+    IWDG_SetPrescaler(IWDG_PRESCALER);
+    IWDG_SetReload(IWDG_RELOAD);
+    IWDG_ReloadCounter();
+    IWDG_Enable();
+    iwdg_running = 1;
+}
+
+/******************************************************************************
+  * @function   delay_iwdg_reload
+  * @brief      Reload the independent watchdog, called from the main loops
+  *             only (not from delay(), a hang in a waiting loop must not be
+  *             hidden). Reloading stops once the CPU watchdog has expired.
+  * @param      None
+  * @retval     None
+  *****************************************************************************/
+void delay_iwdg_reload(void)
+{
+    if (!wdg_expired)
+        IWDG_ReloadCounter();
+}
+
+/******************************************************************************
+  * @function   delay_watchdog_kick
+  * @brief      Restart timeout of the CPU watchdog.
+  * @param      None
+  * @retval     None
+  *****************************************************************************/
+void delay_watchdog_kick(void)
+{
+    wdg_elapsed = 0;
+}
+
+/******************************************************************************
+  * @function   delay_watchdog_remaining
+  * @brief      Time left until the running CPU watchdog resets the board.
+  * @param      None
+  * @retval     Remaining time in seconds (timeout if watchdog doesnt run).
+  *****************************************************************************/
+uint16_t delay_watchdog_remaining(void)
+{
+    uint32_t timeout = (uint32_t)watchdog.watchdog_timeout * 1000u;
+    uint32_t elapsed = wdg_elapsed;
+
+    if (watchdog.watchdog_state != RUN)
+        return watchdog.watchdog_timeout;
+
+    if (elapsed >= timeout)
+        return 0;
+
+    return (timeout - elapsed + 999u) / 1000u;
+}
+
+/******************************************************************************
+  * @function   delay_get_uptime
+  * @brief      Time elapsed since the System Timer was started.
+  * @param      None
+  * @retval     Uptime in miliseconds (wraps after ~49 days).
+  *****************************************************************************/
+uint32_t delay_get_uptime(void)
+{
+    return uptime;
+}
+
+/******************************************************************************
+  * @function   delay_get_time_us
+  * @brief      Time with resolution of microseconds, from uptime and the
+  *             current value of System Timer.
+  * @param      None
+  * @retval     Time in microseconds (wraps after ~71 minutes).
+  *****************************************************************************/
+uint32_t delay_get_time_us(void)
+{
+    uint32_t ms, val;
+
+    /* uptime must not change while SysTick is read */
+    do
+    {
+        ms = uptime;
+        val = SysTick->VAL;
+    } while (ms != uptime);
+
+    return ms * 1000u + (SysTick->LOAD - val) / (SystemCoreClock / 1000000u);
 }
 
 /******************************************************************************
@@ -58,7 +174,7 @@ void delay(volatile uint32_t nTime)
   *****************************************************************************/
 void delay_timing_decrement(void)
 {
-    static uint32_t wdg_cnt;
+    uptime++;
 
     if (timingdelay != 0x00)
     {
@@ -68,18 +184,28 @@ void delay_timing_decrement(void)
 #if WATCHDOG_ENABLE
     if (watchdog.watchdog_state == RUN)
     {
-        wdg_cnt++;
+        wdg_elapsed++;
 
-        if (wdg_cnt >= WATCHDOG_TIMEOUT)
+        if (wdg_elapsed >= (uint32_t)watchdog.watchdog_timeout * 1000u)
         {
             power_control_set_startup_condition();
             power_control_disable_regulators();
-            NVIC_SystemReset(); /* SW reset */
+
+            /* let the independent watchdog reset the MCU, the reset is
+             * then recognized (and counted) by IWDGRST flag */
+            reset_cause_set_fw(RESET_FW_CPU_WATCHDOG);
+            wdg_expired = 1;
+
+            /* it doesn't run with an older bootloader */
+            if (!iwdg_running)
+                NVIC_SystemReset();
+
+            while (1);
         }
     }
     else
     {
-        wdg_cnt = 0;
+        wdg_elapsed = 0;
     }
 #endif
 }
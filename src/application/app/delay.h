@@ -23,9 +23,12 @@ enum watchdog_status {
     WDG_ENABLE           = 1
 };
 
+#define WATCHDOG_DEFAULT_TIMEOUT    120 /* s */
+
 struct st_watchdog {
     watchdog_state_t watchdog_state;
     uint16_t watchdog_sts;
+    uint16_t watchdog_timeout;      /* CPU must stop the watchdog in [s] */
 };
 
 extern struct st_watchdog watchdog;
@@ -46,6 +49,54 @@ void delay_systimer_config(void);
   *****************************************************************************/
 void delay(volatile uint32_t nTime);
 
+/******************************************************************************
+  * @function   delay_iwdg_config
+  * @brief      Start the independent watchdog (if bootloader supports it).
+  * @param      None
+  * @retval     None
+  *****************************************************************************/
+void delay_iwdg_config(void);
+
+/******************************************************************************
+  * @function   delay_iwdg_reload
+  * @brief      Reload the independent watchdog, called from the main loops.
+  * @param      None
+  * @retval     None
+  *****************************************************************************/
+void delay_iwdg_reload(void);
+
+/******************************************************************************
+  * @function   delay_watchdog_kick
+  * @brief      Restart timeout of the CPU watchdog.
+  * @param      None
+  * @retval     None
+  *****************************************************************************/
+void delay_watchdog_kick(void);
+
+/******************************************************************************
+  * @function   delay_watchdog_remaining
+  * @brief      Time left until the running CPU watchdog resets the board.
+  * @param      None
+  * @retval     Remaining time in seconds.
+  *****************************************************************************/
+uint16_t delay_watchdog_remaining(void);
+
+/******************************************************************************
+  * @function   delay_get_uptime
+  * @brief      Time elapsed since the System Timer was started.
+  * @param      None
+  * @retval     Uptime in miliseconds (wraps after ~49 days).
+  *****************************************************************************/
+uint32_t delay_get_uptime(void);
+
+/******************************************************************************
+  * @function   delay_get_time_us
+  * @brief      Time with resolution of microseconds.
+  * @param      None
+  * @retval     Time in microseconds (wraps after ~71 minutes).
+  *****************************************************************************/
+uint32_t delay_get_time_us(void);
+
 /******************************************************************************
   * @function   delay_timing_decrement
   * @brief      Decrements the TimingDelay variable in System Timer and
@@ -32,24 +32,104 @@
 /* Includes ------------------------------------------------------------------*/
 #include "eeprom.h"
 #include "debug_serial.h"
+#include "delay.h"
 
 /* Private typedef -----------------------------------------------------------*/
+struct ee_key {
+  uint16_t VirtAddress;       /* virtual address of the first record */
+  uint8_t Records;            /* number of 16 bit records */
+  uint8_t Type;               /* KEY_VALUE or KEY_BLOB */
+};
+
 /* Private define ------------------------------------------------------------*/
+#define KEY_VALUE             0 /* records are independent 16 or 32 bit values */
+#define KEY_BLOB              1 /* length in bytes followed by data records */
+
+#define NO_VIRT_ADDRESS       ((uint16_t)0xFFFF)
+
+/* Markers of a transaction: begin and commit carry the number of records,
+   abort closes a transaction cut by a power loss */
+#define TXN_BEGIN_VIRT_ADDR   ((uint16_t)0xFFFE)
+#define TXN_COMMIT_VIRT_ADDR  ((uint16_t)0xFFFD)
+#define TXN_ABORT_VIRT_ADDR   ((uint16_t)0xFFFC)
+
 /* Private macro -------------------------------------------------------------*/
+#define NB_OF_KEYS            (sizeof(KeyTab) / sizeof(KeyTab[0]))
+
+/* Pages are used as a ring, variables move to the next page */
+#define NEXT_PAGE(page)       ((uint16_t)(((page) + 1 < EE_PAGE_COUNT) ? (page) + 1 : FirstPage))
+#define PREV_PAGE(page)       ((uint16_t)(((page) > FirstPage) ? (page) - 1 : EE_PAGE_COUNT - 1))
+
+/* Two pages layout of older bootloaders */
+#define LEGACY_FIRST_PAGE     ((uint16_t)(EE_PAGE_COUNT - 2))
+#define LEGACY_LAYOUT()       (FirstPage == LEGACY_FIRST_PAGE)
+
+/* Free records left to an older bootloader, it must not transfer the page
+   (it copies only the variables it knows) */
+#define LEGACY_BOOT_RECORDS   16
+
+/* Bit of the variable in a bitmap of the RAM shadow */
+#define VAR_BIT_GET(map, idx) ((map)[(idx) / 8] & (1 << ((idx) % 8)))
+#define VAR_BIT_SET(map, idx) ((map)[(idx) / 8] |= (1 << ((idx) % 8)))
+#define VAR_BIT_CLR(map, idx) ((map)[(idx) / 8] &= ~(1 << ((idx) % 8)))
+
+/* Page header: status and erase counter */
+#define PAGE_STATUS(page)     (*(__IO uint16_t*)EE_PAGE_ADDRESS(page))
+#define PAGE_ERASE_COUNT(page) (*(__IO uint16_t*)(EE_PAGE_ADDRESS(page) + 2))
+
 /* Private variables ---------------------------------------------------------*/
 
 /* Global variable used to store variable value in read sequence */
 static uint16_t DataVar = 0;
 
-/* Virtual address defined by the user: 0xFFFF value is prohibited */
-static uint16_t VirtAddVarTab[NB_OF_VAR] = {WDG_VIRT_ADDR, RESET_VIRT_ADDR};
+/* Registered keys: 0xFFFF virtual address is prohibited, NB_OF_VAR must be
+ * the sum of their records */
+static const struct ee_key KeyTab[] = {
+  { WDG_VIRT_ADDR,          EE_RECORDS_16,                      KEY_VALUE },
+  { WDG_TIMEOUT_VIRT_ADDR,  EE_RECORDS_16,                      KEY_VALUE },
+  { RESET_VIRT_ADDR,        EE_RECORDS_16,                      KEY_VALUE },
+  { RESET_COUNT_VIRT_ADDR,  RESET_COUNT_NUM * EE_RECORDS_16,    KEY_VALUE },
+  { LED_PROFILE_VIRT_ADDR,  EE_RECORDS_BLOB(LED_PROFILE_SIZE),  KEY_BLOB },
+};
+
+/* RAM shadow of the variables built by EE_Init(), reads do not scan the flash */
+static uint16_t VarCache[NB_OF_VAR];
+static uint8_t VarFound[(NB_OF_VAR + 7) / 8]; /* bit per variable: value is in the cache */
+static uint8_t CacheValid = 0;
+
+/* Deferred writes: the value is in the cache only until EE_Flush(). The cache
+ * is shared with interrupts, its bitmaps are changed with interrupts disabled. */
+static uint8_t VarDirty[(NB_OF_VAR + 7) / 8]; /* bit per variable: value is not in the flash */
+static uint32_t DirtyTime = 0; /* uptime of the last deferred write [ms] */
+
+/* Hint where the next free slot of the active page starts, so writes do not
+ * scan the page from its beginning. It is verified before the slot is used. */
+static uint16_t NextFreePage = NO_VALID_PAGE;
+static uint32_t NextFreeAddress = 0;
+
+/* The first page of the ring, the two pages layout until EE_Init() finds
+   out that the bootloader knows the ring */
+static uint16_t FirstPage = LEGACY_FIRST_PAGE;
 
 /* Private function prototypes -----------------------------------------------*/
 /* Private functions ---------------------------------------------------------*/
 static FLASH_Status EE_Format(void);
+static FLASH_Status EE_ErasePage(uint16_t Page);
+static uint8_t EE_PageIsBlank(uint16_t Page);
 static uint16_t EE_VerifyPageFullWriteVariable(uint16_t VirtAddress, uint16_t Data);
 static uint16_t EE_PageTransfer(uint16_t VirtAddress, uint16_t Data);
 static uint16_t EE_FindValidPage(uint8_t Operation);
+static int16_t EE_FindVarIndex(uint16_t VirtAddress);
+static const struct ee_key *EE_FindKey(uint16_t VirtAddress);
+static uint16_t EE_CopyVariables(uint16_t SkipVirtAddress);
+static uint16_t EE_WriteRecord(uint16_t VirtAddress, uint16_t Data);
+static uint16_t EE_FreeRecords(void);
+static uint8_t EE_CacheClaim(int16_t VarIdx, uint16_t Data, uint8_t* Deferred);
+static void EE_CacheMarkDirty(const int16_t* Dirty, uint16_t Count);
+static uint16_t EE_WriteGroup(const ee_record_t* Records, uint16_t Count);
+static uint16_t EE_FlushGroup(const ee_record_t* Records, const int16_t* Dirty, uint16_t Count);
+static void EE_CacheUpdate(uint16_t VirtAddress, uint16_t Data);
+static uint8_t EE_BuildCache(void);
 
 /**
   * @brief  Restore the pages to a known good state in case of page's status
@@ -60,204 +140,97 @@ static uint16_t EE_FindValidPage(uint8_t Operation);
   */
 uint16_t EE_Init(void)
 {
-  uint16_t PageStatus0 = 6, PageStatus1 = 6;
-  uint16_t VarIdx = 0;
-  uint16_t EepromStatus = 0, ReadStatus = 0;
-  int16_t x = -1;
+  uint16_t Page, ValidPage = NO_VALID_PAGE, ReceivePage = NO_VALID_PAGE;
+  uint16_t ValidCount = 0, ReceiveCount = 0;
+  uint16_t EepromStatus = 0;
   uint16_t  FlashStatus;
 
-  /* Get Page0 status */
-  PageStatus0 = (*(__IO uint16_t*)PAGE0_BASE_ADDRESS);
-  /* Get Page1 status */
-  PageStatus1 = (*(__IO uint16_t*)PAGE1_BASE_ADDRESS);
+  /* Older bootloader reads the two pages layout only */
+  if (BOOT_HAS_FEATURE(BOOT_FEATURE_EE_RING))
+  {
+    FirstPage = 0;
+  }
+  else
+  {
+    FirstPage = LEGACY_FIRST_PAGE;
+  }
 
-  /* Check for invalid header states and repair if necessary */
-  switch (PageStatus0)
+  /* Get status of all pages, the active valid page is the last one of
+     the run of valid pages (the older one waits for erase) */
+  for (Page = FirstPage; Page < EE_PAGE_COUNT; Page++)
   {
-    case ERASED:
-      if (PageStatus1 == VALID_PAGE) /* Page0 erased, Page1 valid */
-      {
-        /* Erase Page0 */
-        FlashStatus = FLASH_ErasePage(PAGE0_BASE_ADDRESS);
-        /* If erase operation was failed, a Flash error code is returned */
-        if (FlashStatus != FLASH_COMPLETE)
-        {
-          return FlashStatus;
-        }
-      }
-      else if (PageStatus1 == RECEIVE_DATA) /* Page0 erased, Page1 receive */
-      {
-        /* Erase Page0 */
-        FlashStatus = FLASH_ErasePage(PAGE0_BASE_ADDRESS);
-        /* If erase operation was failed, a Flash error code is returned */
-        if (FlashStatus != FLASH_COMPLETE)
-        {
-          return FlashStatus;
-        }
-        /* Mark Page1 as valid */
-        FlashStatus = FLASH_ProgramHalfWord(PAGE1_BASE_ADDRESS, VALID_PAGE);
-        /* If program operation was failed, a Flash error code is returned */
-        if (FlashStatus != FLASH_COMPLETE)
-        {
-          return FlashStatus;
-        }
-      }
-      else /* First EEPROM access (Page0&1 are erased) or invalid state -> format EEPROM */
+    if (PAGE_STATUS(Page) == VALID_PAGE)
+    {
+      if (PAGE_STATUS(NEXT_PAGE(Page)) != VALID_PAGE)
       {
-        /* Erase both Page0 and Page1 and set Page0 as valid page */
-        FlashStatus = EE_Format();
-        /* If erase/program operation was failed, a Flash error code is returned */
-        if (FlashStatus != FLASH_COMPLETE)
-        {
-          return FlashStatus;
-        }
+        ValidPage = Page;
+        ValidCount++;
       }
-      break;
+    }
+    else if (PAGE_STATUS(Page) == RECEIVE_DATA)
+    {
+      ReceivePage = Page;
+      ReceiveCount++;
+    }
+  }
 
-    case RECEIVE_DATA:
-      if (PageStatus1 == VALID_PAGE) /* Page0 receive, Page1 valid */
-      {
-        /* Transfer data from Page1 to Page0 */
-        for (VarIdx = 0; VarIdx < NB_OF_VAR; VarIdx++)
-        {
-          if (( *(__IO uint16_t*)(PAGE0_BASE_ADDRESS + 6)) == VirtAddVarTab[VarIdx])
-          {
-            x = VarIdx;
-          }
-          if (VarIdx != x)
-          {
-            /* Read the last variables' updates */
-            ReadStatus = EE_ReadVariable(VirtAddVarTab[VarIdx], &DataVar);
-            /* In case variable corresponding to the virtual address was found */
-            if (ReadStatus != 0x1)
-            {
-              /* Transfer the variable to the Page0 */
-              EepromStatus = EE_VerifyPageFullWriteVariable(VirtAddVarTab[VarIdx], DataVar);
-              /* If program operation was failed, a Flash error code is returned */
-              if (EepromStatus != FLASH_COMPLETE)
-              {
-                return EepromStatus;
-              }
-            }
-          }
-        }
-        /* Mark Page0 as valid */
-        FlashStatus = FLASH_ProgramHalfWord(PAGE0_BASE_ADDRESS, VALID_PAGE);
-        /* If program operation was failed, a Flash error code is returned */
-        if (FlashStatus != FLASH_COMPLETE)
-        {
-          return FlashStatus;
-        }
-        /* Erase Page1 */
-        FlashStatus = FLASH_ErasePage(PAGE1_BASE_ADDRESS);
-        /* If erase operation was failed, a Flash error code is returned */
-        if (FlashStatus != FLASH_COMPLETE)
-        {
-          return FlashStatus;
-        }
-      }
-      else if (PageStatus1 == ERASED) /* Page0 receive, Page1 erased */
-      {
-        /* Erase Page1 */
-        FlashStatus = FLASH_ErasePage(PAGE1_BASE_ADDRESS);
-        /* If erase operation was failed, a Flash error code is returned */
-        if (FlashStatus != FLASH_COMPLETE)
-        {
-          return FlashStatus;
-        }
-        /* Mark Page0 as valid */
-        FlashStatus = FLASH_ProgramHalfWord(PAGE0_BASE_ADDRESS, VALID_PAGE);
-        /* If program operation was failed, a Flash error code is returned */
-        if (FlashStatus != FLASH_COMPLETE)
-        {
-          return FlashStatus;
-        }
-      }
-      else /* Invalid state -> format eeprom */
-      {
-        /* Erase both Page0 and Page1 and set Page0 as valid page */
-        FlashStatus = EE_Format();
-        /* If erase/program operation was failed, a Flash error code is returned */
-        if (FlashStatus != FLASH_COMPLETE)
-        {
-          return FlashStatus;
-        }
-      }
-      break;
+  /* Check for invalid header states and repair if necessary */
+  if ((ValidCount > 1) || (ReceiveCount > 1) || ((ValidCount == 0) && (ReceiveCount == 0)))
+  {
+    /* First EEPROM access (all pages are erased) or invalid state -> format EEPROM */
+    FlashStatus = EE_Format();
+    /* If erase/program operation was failed, a Flash error code is returned */
+    if (FlashStatus != FLASH_COMPLETE)
+    {
+      return FlashStatus;
+    }
+  }
+  else if (ReceiveCount == 1)
+  {
+    if (ValidCount == 1) /* Page transfer was interrupted */
+    {
+      /* Take the committed variables of the valid page */
+      EE_BuildCache();
 
-    case VALID_PAGE:
-      if (PageStatus1 == VALID_PAGE) /* Invalid state -> format eeprom */
-      {
-        /* Erase both Page0 and Page1 and set Page0 as valid page */
-        FlashStatus = EE_Format();
-        /* If erase/program operation was failed, a Flash error code is returned */
-        if (FlashStatus != FLASH_COMPLETE)
-        {
-          return FlashStatus;
-        }
-      }
-      else if (PageStatus1 == ERASED) /* Page0 valid, Page1 erased */
+      /* Transfer data from the valid page to the receiving page, except
+         the variable written there first (it is newer than the old one) */
+      EepromStatus = EE_CopyVariables(*(__IO uint16_t*)(EE_PAGE_ADDRESS(ReceivePage) + 6));
+      /* If program operation was failed, a Flash error code is returned */
+      if (EepromStatus != FLASH_COMPLETE)
       {
-        /* Erase Page1 */
-        FlashStatus = FLASH_ErasePage(PAGE1_BASE_ADDRESS);
-        /* If erase operation was failed, a Flash error code is returned */
-        if (FlashStatus != FLASH_COMPLETE)
-        {
-          return FlashStatus;
-        }
+        return EepromStatus;
       }
-      else /* Page0 valid, Page1 receive */
+
+      /* Old page must not follow the receiving one in the ring, erase it
+         now (transfer of two pages layout goes also backwards). The two
+         pages layout never has two valid pages. */
+      if ((ValidPage != PREV_PAGE(ReceivePage)) || LEGACY_LAYOUT())
       {
-        /* Transfer data from Page0 to Page1 */
-        for (VarIdx = 0; VarIdx < NB_OF_VAR; VarIdx++)
-        {
-          if ((*(__IO uint16_t*)(PAGE1_BASE_ADDRESS + 6)) == VirtAddVarTab[VarIdx])
-          {
-            x = VarIdx;
-          }
-          if (VarIdx != x)
-          {
-            /* Read the last variables' updates */
-            ReadStatus = EE_ReadVariable(VirtAddVarTab[VarIdx], &DataVar);
-            /* In case variable corresponding to the virtual address was found */
-            if (ReadStatus != 0x1)
-            {
-              /* Transfer the variable to the Page1 */
-              EepromStatus = EE_VerifyPageFullWriteVariable(VirtAddVarTab[VarIdx], DataVar);
-              /* If program operation was failed, a Flash error code is returned */
-              if (EepromStatus != FLASH_COMPLETE)
-              {
-                return EepromStatus;
-              }
-            }
-          }
-        }
-        /* Mark Page1 as valid */
-        FlashStatus = FLASH_ProgramHalfWord(PAGE1_BASE_ADDRESS, VALID_PAGE);
-        /* If program operation was failed, a Flash error code is returned */
-        if (FlashStatus != FLASH_COMPLETE)
-        {
-          return FlashStatus;
-        }
-        /* Erase Page0 */
-        FlashStatus = FLASH_ErasePage(PAGE0_BASE_ADDRESS);
+        FlashStatus = EE_ErasePage(ValidPage);
         /* If erase operation was failed, a Flash error code is returned */
         if (FlashStatus != FLASH_COMPLETE)
         {
           return FlashStatus;
         }
       }
-      break;
+    }
 
-    default:  /* Any other state -> format eeprom */
-      /* Erase both Page0 and Page1 and set Page0 as valid page */
-      FlashStatus = EE_Format();
-      /* If erase/program operation was failed, a Flash error code is returned */
-      if (FlashStatus != FLASH_COMPLETE)
-      {
-        return FlashStatus;
-      }
-      break;
+    /* Mark the receiving page as valid, the old one is erased later */
+    FlashStatus = FLASH_ProgramHalfWord(EE_PAGE_ADDRESS(ReceivePage), VALID_PAGE);
+    /* If program operation was failed, a Flash error code is returned */
+    if (FlashStatus != FLASH_COMPLETE)
+    {
+      return FlashStatus;
+    }
+  }
+  /* else one valid page, other pages are erased by EE_Maintenance() */
+
+  /* Pages are consistent now, take all variables to RAM */
+  if (EE_BuildCache())
+  {
+    /* Close the transaction cut by a power loss, so the next records do
+       not continue it */
+    return EE_WriteRecord(TXN_ABORT_VIRT_ADDR, 0);
   }
 
   return FLASH_COMPLETE;
@@ -278,6 +251,24 @@ uint16_t EE_ReadVariable(uint16_t VirtAddress, uint16_t* Data)
   uint16_t ValidPage = PAGE0;
   uint16_t AddressValue = 0x5555, ReadStatus = 1;
   uint32_t Address = 0x08010000, PageStartAddress = 0x08010000;
+  int16_t VarIdx;
+
+  /* Variables of the table are served from the RAM shadow */
+  if (CacheValid)
+  {
+    VarIdx = EE_FindVarIndex(VirtAddress);
+
+    if (VarIdx >= 0)
+    {
+      if (VAR_BIT_GET(VarFound, VarIdx))
+      {
+        *Data = VarCache[VarIdx];
+        return 0;
+      }
+
+      return 1;
+    }
+  }
 
   /* Get active Page for read operation */
   ValidPage = EE_FindValidPage(READ_FROM_VALID_PAGE);
@@ -334,165 +325,606 @@ uint16_t EE_ReadVariable(uint16_t VirtAddress, uint16_t* Data)
   */
 uint16_t EE_WriteVariable(uint16_t VirtAddress, uint16_t Data)
 {
-  uint16_t Status = 0;
+  int16_t VarIdx = EE_FindVarIndex(VirtAddress);
+  uint16_t Status;
+  uint8_t Deferred = 0;
+
+  /* The same value is in the flash already */
+  if (CacheValid && (VarIdx >= 0) && !EE_CacheClaim(VarIdx, Data, &Deferred))
+  {
+    return FLASH_COMPLETE;
+  }
 
   /* Write the variable virtual address and value in the EEPROM */
-  Status = EE_VerifyPageFullWriteVariable(VirtAddress, Data);
+  Status = EE_WriteRecord(VirtAddress, Data);
 
-  /* In case the EEPROM active page is full */
-  if (Status == PAGE_FULL)
+  /* The deferred value is still to be written */
+  if ((Status != FLASH_COMPLETE) && Deferred)
   {
-    /* Perform Page transfer */
-    Status = EE_PageTransfer(VirtAddress, Data);
+    EE_CacheMarkDirty(&VarIdx, 1);
   }
 
-  /* Return last operation status */
   return Status;
 }
 
 /**
-  * @brief  Erases PAGE0 and PAGE1 and writes VALID_PAGE header to PAGE0
-  * @param  None
-  * @retval Status of the last operation (Flash write or erase) done during
-  *         EEPROM formating
+  * @brief  Writes/updates more variables in EEPROM at once. After a power
+  *   loss either all of them or none of them are updated. Variables which
+  *   hold the value already are not written.
+  * @param  Records: virtual addresses and values of the variables
+  * @param  Count: number of the variables (up to EE_TXN_MAX_RECORDS)
+  * @retval Success or error status:
+  *           - FLASH_COMPLETE: on success
+  *           - PAGE_FULL: if valid page is full
+  *           - NO_VALID_PAGE: if no valid page was found
+  *           - VAR_BAD_KEY: if a variable is not registered or there are
+  *             too many of them
+  *           - Flash error code: on write Flash error
   */
-static FLASH_Status EE_Format(void)
+uint16_t EE_WriteTransaction(const ee_record_t* Records, uint16_t Count)
 {
-  FLASH_Status FlashStatus = FLASH_COMPLETE;
+  ee_record_t Write[EE_TXN_MAX_RECORDS];
+  int16_t Dirty[EE_TXN_MAX_RECORDS];
+  uint16_t Idx, Changed = 0, Claimed = 0, Status;
+  int16_t VarIdx;
+  uint8_t Deferred;
 
-  /* Erase Page0 */
-  FlashStatus = FLASH_ErasePage(PAGE0_BASE_ADDRESS);
+  if (Count > EE_TXN_MAX_RECORDS)
+  {
+    return VAR_BAD_KEY;
+  }
 
-  /* If erase operation was failed, a Flash error code is returned */
-  if (FlashStatus != FLASH_COMPLETE)
+  if (!CacheValid)
   {
-    return FlashStatus;
+    return NO_VALID_PAGE;
   }
 
-  /* Set Page0 as valid page: Write VALID_PAGE at Page0 base address */
-  FlashStatus = FLASH_ProgramHalfWord(PAGE0_BASE_ADDRESS, VALID_PAGE);
+  for (Idx = 0; Idx < Count; Idx++)
+  {
+    if (EE_FindVarIndex(Records[Idx].VirtAddress) < 0)
+    {
+      return VAR_BAD_KEY;
+    }
+  }
 
-  /* If program operation was failed, a Flash error code is returned */
-  if (FlashStatus != FLASH_COMPLETE)
+  for (Idx = 0; Idx < Count; Idx++)
   {
-    return FlashStatus;
+    VarIdx = EE_FindVarIndex(Records[Idx].VirtAddress);
+    Deferred = 0;
+
+    if (EE_CacheClaim(VarIdx, Records[Idx].Data, &Deferred))
+    {
+      Write[Changed++] = Records[Idx];
+    }
+
+    if (Deferred)
+    {
+      Dirty[Claimed++] = VarIdx;
+    }
   }
 
-  /* Erase Page1 */
-  FlashStatus = FLASH_ErasePage(PAGE1_BASE_ADDRESS);
+  Status = EE_WriteGroup(Write, Changed);
 
-  /* Return Page1 erase operation status */
-  return FlashStatus;
+  /* The deferred values are still to be written */
+  if (Status != FLASH_COMPLETE)
+  {
+    EE_CacheMarkDirty(Dirty, Claimed);
+  }
+
+  return Status;
 }
 
 /**
-  * @brief  Find valid Page for write or read operation
-  * @param  Operation: operation to achieve on the valid page.
-  *   This parameter can be one of the following values:
-  *     @arg READ_FROM_VALID_PAGE: read operation from valid page
-  *     @arg WRITE_IN_VALID_PAGE: write operation from valid page
-  * @retval Valid page number (PAGE0 or PAGE1) or NO_VALID_PAGE in case
-  *   of no valid page was found
+  * @brief  Updates variable data in RAM only, it is written to EEPROM by
+  *   EE_Flush(). More changes of the variable take one flash write then.
+  *   Variables out of the RAM shadow are written at once. Can be called from
+  *   an interrupt.
+  * @param  VirtAddress: Variable virtual address
+  * @param  Data: 16 bit data to be written
+  * @retval Success or error status:
+  *           - FLASH_COMPLETE: on success
+  *           - Status of EE_WriteVariable() if the write was not deferred
   */
-static uint16_t EE_FindValidPage(uint8_t Operation)
+uint16_t EE_WriteVariableDeferred(uint16_t VirtAddress, uint16_t Data)
 {
-  uint16_t PageStatus0 = 6, PageStatus1 = 6;
+  int16_t VarIdx = EE_FindVarIndex(VirtAddress);
+  uint32_t primask;
 
-  /* Get Page0 actual status */
-  PageStatus0 = (*(__IO uint16_t*)PAGE0_BASE_ADDRESS);
+  if (!CacheValid || (VarIdx < 0))
+  {
+    return EE_WriteVariable(VirtAddress, Data);
+  }
 
-  /* Get Page1 actual status */
-  PageStatus1 = (*(__IO uint16_t*)PAGE1_BASE_ADDRESS);
+  primask = __get_PRIMASK();
+  __disable_irq();
 
-  /* Write or read operation */
-  switch (Operation)
+  if (!VAR_BIT_GET(VarFound, VarIdx) || VAR_BIT_GET(VarDirty, VarIdx) ||
+      (VarCache[VarIdx] != Data))
   {
-    case WRITE_IN_VALID_PAGE:   /* ---- Write operation ---- */
-      if (PageStatus1 == VALID_PAGE)
-      {
-        /* Page0 receiving data */
-        if (PageStatus0 == RECEIVE_DATA)
-        {
-          return PAGE0;         /* Page0 valid */
-        }
-        else
-        {
-          return PAGE1;         /* Page1 valid */
-        }
-      }
-      else if (PageStatus0 == VALID_PAGE)
+    VarCache[VarIdx] = Data;
+    VAR_BIT_SET(VarFound, VarIdx);
+    VAR_BIT_SET(VarDirty, VarIdx);
+    DirtyTime = delay_get_uptime();
+  }
+
+  __set_PRIMASK(primask);
+
+  return FLASH_COMPLETE;
+}
+
+/**
+  * @brief  Writes variables updated by EE_WriteVariableDeferred() to EEPROM,
+  *   they are written as one transaction
+  * @param  QuietTime: write them only if there was no deferred write for
+  *   this time [ms], 0 - write them now (e.g. before a reset)
+  * @retval Success or error status:
+  *           - FLASH_COMPLETE: on success (or nothing to write)
+  *           - PAGE_FULL: if valid page is full
+  *           - NO_VALID_PAGE: if no valid page was found
+  *           - Flash error code: on write Flash error
+  */
+uint16_t EE_Flush(uint32_t QuietTime)
+{
+  ee_record_t Records[EE_TXN_MAX_RECORDS];
+  int16_t Dirty[EE_TXN_MAX_RECORDS];
+  uint16_t KeyIdx, Record, Count = 0, Status;
+  int16_t VarIdx = 0;
+  uint32_t primask;
+
+  if (QuietTime && ((delay_get_uptime() - DirtyTime) < QuietTime))
+  {
+    return FLASH_COMPLETE;
+  }
+
+  /* Variables changed together are committed together (in groups of
+     EE_TXN_MAX_RECORDS) */
+  for (KeyIdx = 0; KeyIdx < NB_OF_KEYS; KeyIdx++)
+  {
+    for (Record = 0; Record < KeyTab[KeyIdx].Records; Record++, VarIdx++)
+    {
+      if (Count == EE_TXN_MAX_RECORDS)
       {
-        /* Page1 receiving data */
-        if (PageStatus1 == RECEIVE_DATA)
+        Status = EE_FlushGroup(Records, Dirty, Count);
+        if (Status != FLASH_COMPLETE)
         {
-          return PAGE1;         /* Page1 valid */
+          return Status;
         }
-        else
-        {
-          return PAGE0;         /* Page0 valid */
-        }
-      }
-      else
-      {
-        return NO_VALID_PAGE;   /* No valid Page */
+        Count = 0;
       }
 
-    case READ_FROM_VALID_PAGE:  /* ---- Read operation ---- */
-      if (PageStatus0 == VALID_PAGE)
-      {
-        return PAGE0;           /* Page0 valid */
-      }
-      else if (PageStatus1 == VALID_PAGE)
-      {
-        return PAGE1;           /* Page1 valid */
-      }
-      else
+      primask = __get_PRIMASK();
+      __disable_irq();
+
+      if (VAR_BIT_GET(VarDirty, VarIdx))
       {
-        return NO_VALID_PAGE ;  /* No valid Page */
+        /* A newer deferred write during the flash write marks it again */
+        Records[Count].VirtAddress = KeyTab[KeyIdx].VirtAddress + Record;
+        Records[Count].Data = VarCache[VarIdx];
+        Dirty[Count++] = VarIdx;
+        VAR_BIT_CLR(VarDirty, VarIdx);
       }
 
-    default:
-      return PAGE0;             /* Page0 valid */
+      __set_PRIMASK(primask);
+    }
   }
+
+  return EE_FlushGroup(Records, Dirty, Count);
 }
 
 /**
-  * @brief  Verify if active page is full and Writes variable in EEPROM.
-  * @param  VirtAddress: 16 bit virtual address of the variable
-  * @param  Data: 16 bit data to be written as variable value
+  * @brief  Returns the last stored 32 bit value of the key
+  * @param  VirtAddress: virtual address of the key, it takes two records
+  *   (low and high half-word)
+  * @param  Data: Global variable contains the read value
+  * @retval Success or error status:
+  *           - 0: if the value was found
+  *           - 1: if the value was not found
+  *           - NO_VALID_PAGE: if no valid page was found
+  *           - VAR_BAD_KEY: if the key is not registered for 32 bit value
+  */
+uint16_t EE_ReadVariable32(uint16_t VirtAddress, uint32_t* Data)
+{
+  const struct ee_key *Key = EE_FindKey(VirtAddress);
+  uint16_t Low = 0, High = 0, ReadStatus;
+
+  if ((Key == 0) || (Key->Type != KEY_VALUE) || (Key->Records < EE_RECORDS_32))
+  {
+    return VAR_BAD_KEY;
+  }
+
+  ReadStatus = EE_ReadVariable(VirtAddress, &Low);
+  if (ReadStatus != 0)
+  {
+    return ReadStatus;
+  }
+
+  ReadStatus = EE_ReadVariable(VirtAddress + 1, &High);
+  if (ReadStatus != 0)
+  {
+    return ReadStatus;
+  }
+
+  *Data = Low | ((uint32_t)High << 16);
+
+  return 0;
+}
+
+/**
+  * @brief  Writes/updates 32 bit value of the key in EEPROM.
+  * @param  VirtAddress: virtual address of the key
+  * @param  Data: 32 bit data to be written
   * @retval Success or error status:
   *           - FLASH_COMPLETE: on success
   *           - PAGE_FULL: if valid page is full
   *           - NO_VALID_PAGE: if no valid page was found
+  *           - VAR_BAD_KEY: if the key is not registered for 32 bit value
   *           - Flash error code: on write Flash error
   */
-static uint16_t EE_VerifyPageFullWriteVariable(uint16_t VirtAddress, uint16_t Data)
+uint16_t EE_WriteVariable32(uint16_t VirtAddress, uint32_t Data)
 {
-  FLASH_Status FlashStatus = FLASH_COMPLETE;
-  uint16_t ValidPage = PAGE0;
-  uint32_t Address = 0x08010000, PageEndAddress = 0x080107FF;
+  const struct ee_key *Key = EE_FindKey(VirtAddress);
+  ee_record_t Records[EE_RECORDS_32];
 
-  /* Get valid Page for write operation */
-  ValidPage = EE_FindValidPage(WRITE_IN_VALID_PAGE);
-
-  /* Check if there is no valid page */
-  if (ValidPage == NO_VALID_PAGE)
+  if ((Key == 0) || (Key->Type != KEY_VALUE) || (Key->Records < EE_RECORDS_32))
   {
-    return  NO_VALID_PAGE;
+    return VAR_BAD_KEY;
   }
 
-  /* Get the valid Page start Address */
-  Address = (uint32_t)(EEPROM_START_ADDRESS + (uint32_t)(ValidPage * PAGE_SIZE));
+  Records[0].VirtAddress = VirtAddress;
+  Records[0].Data = Data & 0xFFFF;
+  Records[1].VirtAddress = VirtAddress + 1;
+  Records[1].Data = Data >> 16;
+
+  /* Both halves are updated together */
+  return EE_WriteTransaction(Records, EE_RECORDS_32);
+}
+
+/**
+  * @brief  Returns the last stored blob of the key
+  * @param  VirtAddress: virtual address of the key
+  * @param  Data: buffer for the blob
+  * @param  Size: size of the buffer
+  * @param  Length: length of the read blob
+  * @retval Success or error status:
+  *           - 0: if the blob was found
+  *           - 1: if the blob (or a part of it) was not found
+  *           - NO_VALID_PAGE: if no valid page was found
+  *           - VAR_BAD_KEY: if the key is not a blob or the buffer is small
+  */
+uint16_t EE_ReadBlob(uint16_t VirtAddress, uint8_t* Data, uint16_t Size, uint16_t* Length)
+{
+  const struct ee_key *Key = EE_FindKey(VirtAddress);
+  uint16_t BlobLength = 0, Value = 0, Idx, ReadStatus;
+
+  if ((Key == 0) || (Key->Type != KEY_BLOB))
+  {
+    return VAR_BAD_KEY;
+  }
+
+  ReadStatus = EE_ReadVariable(VirtAddress, &BlobLength);
+  if (ReadStatus != 0)
+  {
+    return ReadStatus;
+  }
+
+  if ((BlobLength > Size) || (EE_RECORDS_BLOB(BlobLength) > Key->Records))
+  {
+    return VAR_BAD_KEY;
+  }
+
+  for (Idx = 0; Idx < BlobLength; Idx += 2)
+  {
+    ReadStatus = EE_ReadVariable(VirtAddress + 1 + Idx / 2, &Value);
+    if (ReadStatus != 0)
+    {
+      return ReadStatus;
+    }
+
+    Data[Idx] = Value & 0xFF;
+    if (Idx + 1 < BlobLength)
+    {
+      Data[Idx + 1] = Value >> 8;
+    }
+  }
+
+  *Length = BlobLength;
+
+  return 0;
+}
+
+/**
+  * @brief  Writes/updates blob of the key in EEPROM. Data and length records
+  *   are written in one transaction.
+  * @param  VirtAddress: virtual address of the key
+  * @param  Data: blob to be written
+  * @param  Length: length of the blob in bytes
+  * @retval Success or error status:
+  *           - FLASH_COMPLETE: on success
+  *           - PAGE_FULL: if valid page is full
+  *           - NO_VALID_PAGE: if no valid page was found
+  *           - VAR_BAD_KEY: if the key is not a blob or the blob is too big
+  *           - Flash error code: on write Flash error
+  */
+uint16_t EE_WriteBlob(uint16_t VirtAddress, const uint8_t* Data, uint16_t Length)
+{
+  const struct ee_key *Key = EE_FindKey(VirtAddress);
+  ee_record_t Records[EE_TXN_MAX_RECORDS];
+  uint16_t Idx, Count = 0;
+
+  if ((Key == 0) || (Key->Type != KEY_BLOB) || (EE_RECORDS_BLOB(Length) > Key->Records) ||
+      (EE_RECORDS_BLOB(Length) > EE_TXN_MAX_RECORDS))
+  {
+    return VAR_BAD_KEY;
+  }
+
+  for (Idx = 0; Idx < Length; Idx += 2)
+  {
+    Records[Count].VirtAddress = VirtAddress + 1 + Idx / 2;
+    Records[Count].Data = Data[Idx];
+    if (Idx + 1 < Length)
+    {
+      Records[Count].Data |= Data[Idx + 1] << 8;
+    }
+    Count++;
+  }
+
+  Records[Count].VirtAddress = VirtAddress;
+  Records[Count].Data = Length;
+  Count++;
+
+  /* Data and length are updated together */
+  return EE_WriteTransaction(Records, Count);
+}
+
+/**
+  * @brief  Erase pages in background, so a page transfer does not wait for
+  *   them: the old page left valid by the last page transfer and the page
+  *   the next transfer goes to. One page is erased per call at most.
+  * @param  None
+  * @retval Success or error status:
+  *           - FLASH_COMPLETE: on success
+  *           - NO_VALID_PAGE: if no valid page was found
+  *           - Flash error code: on erase Flash error
+  */
+uint16_t EE_Maintenance(void)
+{
+  uint16_t ValidPage, Page;
+
+  ValidPage = EE_FindValidPage(READ_FROM_VALID_PAGE);
+
+  /* Nothing to do in the middle of a page transfer */
+  if ((ValidPage == NO_VALID_PAGE) || (EE_FindValidPage(WRITE_IN_VALID_PAGE) != ValidPage))
+  {
+    return NO_VALID_PAGE;
+  }
+
+  /* Old valid page of the last page transfer */
+  for (Page = NEXT_PAGE(ValidPage); Page != ValidPage; Page = NEXT_PAGE(Page))
+  {
+    if (PAGE_STATUS(Page) == VALID_PAGE)
+    {
+      return EE_ErasePage(Page);
+    }
+  }
+
+  /* Page of the next page transfer */
+  if (!EE_PageIsBlank(NEXT_PAGE(ValidPage)))
+  {
+    return EE_ErasePage(NEXT_PAGE(ValidPage));
+  }
+
+  /* Older bootloader would transfer the page without variables it does
+     not know, so the transfer is done here in advance */
+  if (LEGACY_LAYOUT() && (EE_FreeRecords() < LEGACY_BOOT_RECORDS))
+  {
+    return EE_PageTransfer(NO_VIRT_ADDRESS, 0);
+  }
+
+  return FLASH_COMPLETE;
+}
+
+/**
+  * @brief  Returns number of erases of the page
+  * @param  Page: page of the EEPROM emulation (0 .. EE_PAGE_COUNT - 1)
+  * @retval Erase count, it stops at 0xFFFE, ERASED (0xFFFF) if the page is
+  *   not used (two pages layout of an older bootloader)
+  */
+uint16_t EE_GetEraseCount(uint16_t Page)
+{
+  uint16_t EraseCount;
+
+  if ((Page < FirstPage) || (Page >= EE_PAGE_COUNT))
+  {
+    return ERASED;
+  }
+
+  EraseCount = PAGE_ERASE_COUNT(Page);
+
+  /* Page was never erased by the emulation */
+  return (EraseCount == ERASED) ? 0 : EraseCount;
+}
+
+/**
+  * @brief  Erases all pages which are not blank and writes VALID_PAGE header
+  *   to the first page
+  * @param  None
+  * @retval Status of the last operation (Flash write or erase) done during
+  *         EEPROM formating
+  */
+static FLASH_Status EE_Format(void)
+{
+  FLASH_Status FlashStatus = FLASH_COMPLETE;
+  uint16_t Page;
+
+  NextFreePage = NO_VALID_PAGE;
+
+  /* Erase all pages first, so no old valid page is left beside the new one */
+  for (Page = FirstPage; Page < EE_PAGE_COUNT; Page++)
+  {
+    if (!EE_PageIsBlank(Page))
+    {
+      FlashStatus = EE_ErasePage(Page);
+
+      /* If erase operation was failed, a Flash error code is returned */
+      if (FlashStatus != FLASH_COMPLETE)
+      {
+        return FlashStatus;
+      }
+    }
+  }
+
+  /* Set the first page as valid page: Write VALID_PAGE at its base address */
+  FlashStatus = FLASH_ProgramHalfWord(EE_PAGE_ADDRESS(FirstPage), VALID_PAGE);
+
+  /* Return program operation status */
+  return FlashStatus;
+}
+
+/**
+  * @brief  Erases the page and increments its erase counter
+  * @param  Page: page of the EEPROM emulation
+  * @retval Status of the last operation (Flash write or erase)
+  */
+static FLASH_Status EE_ErasePage(uint16_t Page)
+{
+  FLASH_Status FlashStatus = FLASH_COMPLETE;
+  uint16_t EraseCount = EE_GetEraseCount(Page);
+
+  if (NextFreePage == Page)
+  {
+    NextFreePage = NO_VALID_PAGE;
+  }
+
+  FlashStatus = FLASH_ErasePage(EE_PAGE_ADDRESS(Page));
+
+  /* If erase operation was failed, a Flash error code is returned */
+  if (FlashStatus != FLASH_COMPLETE)
+  {
+    return FlashStatus;
+  }
+
+  if (EraseCount < 0xFFFE)
+  {
+    EraseCount++;
+  }
+
+  /* Counter is kept in the header, the page status stays ERASED */
+  return FLASH_ProgramHalfWord(EE_PAGE_ADDRESS(Page) + 2, EraseCount);
+}
+
+/**
+  * @brief  Check that the page is erased and can receive data
+  * @param  Page: page of the EEPROM emulation
+  * @retval 1 if the page is blank, 0 otherwise
+  */
+static uint8_t EE_PageIsBlank(uint16_t Page)
+{
+  uint32_t Address = EE_PAGE_ADDRESS(Page) + 4;
+
+  if (PAGE_STATUS(Page) != ERASED)
+  {
+    return 0;
+  }
+
+  while (Address < EE_PAGE_ADDRESS(Page + 1))
+  {
+    if ((*(__IO uint32_t*)Address) != 0xFFFFFFFF)
+    {
+      return 0;
+    }
+
+    Address = Address + 4;
+  }
+
+  return 1;
+}
+
+/**
+  * @brief  Find valid Page for write or read operation
+  * @param  Operation: operation to achieve on the valid page.
+  *   This parameter can be one of the following values:
+  *     @arg READ_FROM_VALID_PAGE: read operation from valid page
+  *     @arg WRITE_IN_VALID_PAGE: write operation from valid page
+  * @retval Valid page number or NO_VALID_PAGE in case of no valid page was
+  *   found
+  */
+static uint16_t EE_FindValidPage(uint8_t Operation)
+{
+  uint16_t Page, ValidPage = NO_VALID_PAGE, ReceivePage = NO_VALID_PAGE;
+
+  for (Page = FirstPage; Page < EE_PAGE_COUNT; Page++)
+  {
+    if (PAGE_STATUS(Page) == VALID_PAGE)
+    {
+      /* The last page of the run is valid, the older one waits for erase */
+      if (PAGE_STATUS(NEXT_PAGE(Page)) != VALID_PAGE)
+      {
+        ValidPage = Page;
+      }
+    }
+    else if (PAGE_STATUS(Page) == RECEIVE_DATA)
+    {
+      ReceivePage = Page;
+    }
+  }
+
+  /* Page receiving data during a page transfer is written */
+  if ((Operation == WRITE_IN_VALID_PAGE) && (ValidPage != NO_VALID_PAGE) &&
+      (ReceivePage != NO_VALID_PAGE))
+  {
+    return ReceivePage;
+  }
+
+  return ValidPage;
+}
+
+/**
+  * @brief  Verify if active page is full and Writes variable in EEPROM.
+  * @param  VirtAddress: 16 bit virtual address of the variable
+  * @param  Data: 16 bit data to be written as variable value
+  * @retval Success or error status:
+  *           - FLASH_COMPLETE: on success
+  *           - PAGE_FULL: if valid page is full
+  *           - NO_VALID_PAGE: if no valid page was found
+  *           - Flash error code: on write Flash error
+  */
+static uint16_t EE_VerifyPageFullWriteVariable(uint16_t VirtAddress, uint16_t Data)
+{
+  FLASH_Status FlashStatus = FLASH_COMPLETE;
+  uint16_t ValidPage = PAGE0;
+  uint32_t Address = 0x08010000, PageEndAddress = 0x080107FF;
+
+  /* Get valid Page for write operation */
+  ValidPage = EE_FindValidPage(WRITE_IN_VALID_PAGE);
+
+  /* Check if there is no valid page */
+  if (ValidPage == NO_VALID_PAGE)
+  {
+    return  NO_VALID_PAGE;
+  }
+
+  /* Get the valid Page start Address */
+  Address = (uint32_t)(EEPROM_START_ADDRESS + (uint32_t)(ValidPage * PAGE_SIZE));
 
   /* Get the valid Page end Address */
   PageEndAddress = (uint32_t)((EEPROM_START_ADDRESS - 2) + (uint32_t)((1 + ValidPage) * PAGE_SIZE));
 
+  /* Skip the used part of the page, if it is known */
+  if ((NextFreePage == ValidPage) && (NextFreeAddress > Address))
+  {
+    Address = NextFreeAddress;
+  }
+
   /* Check each active page address starting from begining */
   while (Address < PageEndAddress)
   {
     /* Verify if Address and Address+2 contents are 0xFFFFFFFF */
     if ((*(__IO uint32_t*)Address) == 0xFFFFFFFF)
     {
+      /* The slot is used even if programming fails */
+      NextFreePage = ValidPage;
+      NextFreeAddress = Address + 4;
+
       /* Set variable data */
       FlashStatus = FLASH_ProgramHalfWord(Address, Data);
       /* If program operation was failed, a Flash error code is returned */
@@ -502,6 +934,7 @@ static uint16_t EE_VerifyPageFullWriteVariable(uint16_t VirtAddress, uint16_t Da
       }
       /* Set variable virtual address */
       FlashStatus = FLASH_ProgramHalfWord(Address + 2, VirtAddress);
+
       /* Return program operation status */
       return FlashStatus;
     }
@@ -512,14 +945,20 @@ static uint16_t EE_VerifyPageFullWriteVariable(uint16_t VirtAddress, uint16_t Da
     }
   }
 
+  NextFreePage = ValidPage;
+  NextFreeAddress = PageEndAddress;
+
   /* Return PAGE_FULL in case the valid page is full */
   return PAGE_FULL;
 }
 
 /**
   * @brief  Transfers last updated variables data from the full Page to
-  *   an empty one.
-  * @param  VirtAddress: 16 bit virtual address of the variable
+  *   the next page of the ring. The full page stays valid and is erased
+  *   later by EE_Maintenance(), in the two pages layout it is erased before
+  *   the new page becomes valid (older bootloaders expect that).
+  * @param  VirtAddress: 16 bit virtual address of the variable, NO_VIRT_ADDRESS
+  *   if only the variables are moved
   * @param  Data: 16 bit data to be written as variable value
   * @retval Success or error status:
   *           - FLASH_COMPLETE: on success
@@ -530,65 +969,235 @@ static uint16_t EE_VerifyPageFullWriteVariable(uint16_t VirtAddress, uint16_t Da
 static uint16_t EE_PageTransfer(uint16_t VirtAddress, uint16_t Data)
 {
   FLASH_Status FlashStatus = FLASH_COMPLETE;
-  uint32_t NewPageAddress = 0x080103FF, OldPageAddress = 0x08010000;
-  uint16_t ValidPage = PAGE0, VarIdx = 0;
-  uint16_t EepromStatus = 0, ReadStatus = 0;
+  uint16_t ValidPage = PAGE0, NewPage, Page;
+  uint16_t EepromStatus = 0;
 
   /* Get active Page for read operation */
   ValidPage = EE_FindValidPage(READ_FROM_VALID_PAGE);
 
-  if (ValidPage == PAGE1)       /* Page1 valid */
+  if (ValidPage == NO_VALID_PAGE)
   {
-    /* New page address where variable will be moved to */
-    NewPageAddress = PAGE0_BASE_ADDRESS;
-
-    /* Old page address where variable will be taken from */
-    OldPageAddress = PAGE1_BASE_ADDRESS;
-    DBG("PAGE1 VALID\r\n");
+    DBG("NO VALID PAGE\r\n");
+    return NO_VALID_PAGE;       /* No valid Page */
   }
-  else if (ValidPage == PAGE0)  /* Page0 valid */
-  {
-    /* New page address where variable will be moved to */
-    NewPageAddress = PAGE1_BASE_ADDRESS;
 
-    /* Old page address where variable will be taken from */
-    OldPageAddress = PAGE0_BASE_ADDRESS;
-    DBG("PAGE0 VALID\r\n");
-  }
-  else
+  /* New page where variables will be moved to */
+  NewPage = NEXT_PAGE(ValidPage);
+  DBG("PAGE %d -> %d\r\n", ValidPage, NewPage);
+
+  /* Old valid page of the previous transfer and the new page are erased
+     by EE_Maintenance() normally, do it now if it had no chance */
+  for (Page = NewPage; Page != ValidPage; Page = NEXT_PAGE(Page))
   {
-    DBG("NO VALID PAGE\r\n");
-    return NO_VALID_PAGE;       /* No valid Page */
+    if ((PAGE_STATUS(Page) == VALID_PAGE) || ((Page == NewPage) && !EE_PageIsBlank(Page)))
+    {
+      FlashStatus = EE_ErasePage(Page);
+      /* If erase operation was failed, a Flash error code is returned */
+      if (FlashStatus != FLASH_COMPLETE)
+      {
+        return FlashStatus;
+      }
+    }
   }
 
+  /* The new page was used before, the free slot hint is not valid */
+  NextFreePage = NO_VALID_PAGE;
+
   /* Set the new Page status to RECEIVE_DATA status */
-  FlashStatus = FLASH_ProgramHalfWord(NewPageAddress, RECEIVE_DATA);
+  FlashStatus = FLASH_ProgramHalfWord(EE_PAGE_ADDRESS(NewPage), RECEIVE_DATA);
   /* If program operation was failed, a Flash error code is returned */
   if (FlashStatus != FLASH_COMPLETE)
   {
     return FlashStatus;
   }
 
-  /* Write the variable passed as parameter in the new active page */
-  EepromStatus = EE_VerifyPageFullWriteVariable(VirtAddress, Data);
+  /* Write the variable passed as parameter in the new active page (if any) */
+  if (VirtAddress != NO_VIRT_ADDRESS)
+  {
+    EepromStatus = EE_VerifyPageFullWriteVariable(VirtAddress, Data);
+    /* If program operation was failed, a Flash error code is returned */
+    if (EepromStatus != FLASH_COMPLETE)
+    {
+      return EepromStatus;
+    }
+  }
+
+  /* Transfer process: transfer variables from old to the new active page,
+     except the one passed as parameter */
+  EepromStatus = EE_CopyVariables(VirtAddress);
   /* If program operation was failed, a Flash error code is returned */
   if (EepromStatus != FLASH_COMPLETE)
   {
     return EepromStatus;
   }
 
-  /* Transfer process: transfer variables from old to the new active page */
-  for (VarIdx = 0; VarIdx < NB_OF_VAR; VarIdx++)
+  /* Older bootloaders never expect two valid pages */
+  if (LEGACY_LAYOUT())
   {
-    if (VirtAddVarTab[VarIdx] != VirtAddress)  /* Check each variable except the one passed as parameter */
+    FlashStatus = EE_ErasePage(ValidPage);
+    /* If erase operation was failed, a Flash error code is returned */
+    if (FlashStatus != FLASH_COMPLETE)
     {
-      /* Read the other last variable updates */
-      ReadStatus = EE_ReadVariable(VirtAddVarTab[VarIdx], &DataVar);
-      /* In case variable corresponding to the virtual address was found */
-      if (ReadStatus != 0x1)
+      return FlashStatus;
+    }
+  }
+
+  /* Set new Page status to VALID_PAGE status, it follows the old page in
+     the ring, so it takes over */
+  FlashStatus = FLASH_ProgramHalfWord(EE_PAGE_ADDRESS(NewPage), VALID_PAGE);
+  /* If program operation was failed, a Flash error code is returned */
+  if (FlashStatus != FLASH_COMPLETE)
+  {
+    return FlashStatus;
+  }
+
+  /* Return last operation flash status */
+  return FlashStatus;
+}
+
+/**
+  * @brief  Writes variable data in EEPROM, the page is transferred if it is
+  *   full.
+  * @param  VirtAddress: Variable virtual address
+  * @param  Data: 16 bit data to be written
+  * @retval Success or error status:
+  *           - FLASH_COMPLETE: on success
+  *           - PAGE_FULL: if valid page is full
+  *           - NO_VALID_PAGE: if no valid page was found
+  *           - Flash error code: on write Flash error
+  */
+static uint16_t EE_WriteRecord(uint16_t VirtAddress, uint16_t Data)
+{
+  uint16_t Status = 0;
+
+  /* Write the variable virtual address and value in the EEPROM */
+  Status = EE_VerifyPageFullWriteVariable(VirtAddress, Data);
+
+  /* In case the EEPROM active page is full */
+  if (Status == PAGE_FULL)
+  {
+    /* Perform Page transfer */
+    Status = EE_PageTransfer(VirtAddress, Data);
+  }
+
+  if (Status == FLASH_COMPLETE)
+  {
+    EE_CacheUpdate(VirtAddress, Data);
+  }
+
+  /* Return last operation status */
+  return Status;
+}
+
+/**
+  * @brief  Number of free records of the page for write operation
+  * @param  None
+  * @retval Free records
+  */
+static uint16_t EE_FreeRecords(void)
+{
+  uint16_t ValidPage = EE_FindValidPage(WRITE_IN_VALID_PAGE);
+  uint32_t Address, PageEndAddress;
+
+  if (ValidPage == NO_VALID_PAGE)
+  {
+    return 0;
+  }
+
+  Address = EE_PAGE_ADDRESS(ValidPage) + 4;
+  PageEndAddress = EE_PAGE_ADDRESS(ValidPage + 1);
+
+  /* Skip the used part of the page, if it is known */
+  if ((NextFreePage == ValidPage) && (NextFreeAddress > Address))
+  {
+    Address = NextFreeAddress;
+  }
+
+  while ((Address < PageEndAddress) && ((*(__IO uint32_t*)Address) != 0xFFFFFFFF))
+  {
+    Address = Address + 4;
+  }
+
+  return (PageEndAddress - Address) / 4;
+}
+
+/**
+  * @brief  Find the variable in the table of virtual addresses
+  * @param  VirtAddress: 16 bit virtual address of the variable
+  * @retval Index of the variable, -1 if it is not in the table
+  */
+static int16_t EE_FindVarIndex(uint16_t VirtAddress)
+{
+  uint16_t KeyIdx;
+  int16_t VarIdx = 0;
+
+  for (KeyIdx = 0; KeyIdx < NB_OF_KEYS; KeyIdx++)
+  {
+    if ((uint16_t)(VirtAddress - KeyTab[KeyIdx].VirtAddress) < KeyTab[KeyIdx].Records)
+    {
+      return VarIdx + (VirtAddress - KeyTab[KeyIdx].VirtAddress);
+    }
+
+    VarIdx += KeyTab[KeyIdx].Records;
+  }
+
+  return -1;
+}
+
+/**
+  * @brief  Find the registered key
+  * @param  VirtAddress: virtual address of the first record of the key
+  * @retval Key, 0 if it is not registered
+  */
+static const struct ee_key *EE_FindKey(uint16_t VirtAddress)
+{
+  uint16_t KeyIdx;
+
+  for (KeyIdx = 0; KeyIdx < NB_OF_KEYS; KeyIdx++)
+  {
+    if (KeyTab[KeyIdx].VirtAddress == VirtAddress)
+    {
+      return &KeyTab[KeyIdx];
+    }
+  }
+
+  return 0;
+}
+
+/**
+  * @brief  Copy records of all keys from the valid page to the page
+  *   receiving data. All records of a blob are copied, data of a longer blob
+  *   can be written before its length.
+  * @param  SkipVirtAddress: record already written to the receiving page
+  * @retval Success or error status:
+  *           - FLASH_COMPLETE: on success
+  *           - PAGE_FULL: if receiving page is full
+  *           - NO_VALID_PAGE: if no valid page was found
+  *           - Flash error code: on write Flash error
+  */
+static uint16_t EE_CopyVariables(uint16_t SkipVirtAddress)
+{
+  uint16_t KeyIdx, Record, VirtAddress;
+  uint16_t EepromStatus;
+
+  /* Records behind the length of a blob are copied too, a longer blob
+     written later skips the records which hold its data already */
+  for (KeyIdx = 0; KeyIdx < NB_OF_KEYS; KeyIdx++)
+  {
+    for (Record = 0; Record < KeyTab[KeyIdx].Records; Record++)
+    {
+      VirtAddress = KeyTab[KeyIdx].VirtAddress + Record;
+
+      if (VirtAddress == SkipVirtAddress)
+      {
+        continue;
+      }
+
+      /* Read the last variables' updates */
+      if (EE_ReadVariable(VirtAddress, &DataVar) == 0)
       {
-        /* Transfer the variable to the new active page */
-        EepromStatus = EE_VerifyPageFullWriteVariable(VirtAddVarTab[VarIdx], DataVar);
+        /* Transfer the variable to the receiving page */
+        EepromStatus = EE_VerifyPageFullWriteVariable(VirtAddress, DataVar);
         /* If program operation was failed, a Flash error code is returned */
         if (EepromStatus != FLASH_COMPLETE)
         {
@@ -598,24 +1207,246 @@ static uint16_t EE_PageTransfer(uint16_t VirtAddress, uint16_t Data)
     }
   }
 
-  /* Erase the old Page: Set old Page status to ERASED status */
-  FlashStatus = FLASH_ErasePage(OldPageAddress);
-  /* If erase operation was failed, a Flash error code is returned */
-  if (FlashStatus != FLASH_COMPLETE)
+  return FLASH_COMPLETE;
+}
+
+/**
+  * @brief  Check whether the value must be written to the flash. It takes
+  *   the place of a deferred value then, the caller marks the variable dirty
+  *   again if the write fails.
+  * @param  VarIdx: index of the variable
+  * @param  Data: 16 bit value of the variable
+  * @param  Deferred: set to 1 if a deferred value was taken over
+  * @retval 1 if the value must be written, 0 if it is in the flash already
+  */
+static uint8_t EE_CacheClaim(int16_t VarIdx, uint16_t Data, uint8_t* Deferred)
+{
+  uint8_t Write = 1;
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+
+  if (VAR_BIT_GET(VarDirty, VarIdx))
   {
-    return FlashStatus;
+    VAR_BIT_CLR(VarDirty, VarIdx);
+    *Deferred = 1;
+  }
+  else if (VAR_BIT_GET(VarFound, VarIdx) && (VarCache[VarIdx] == Data))
+  {
+    Write = 0;
   }
 
-  /* Set new Page status to VALID_PAGE status */
-  FlashStatus = FLASH_ProgramHalfWord(NewPageAddress, VALID_PAGE);
-  /* If program operation was failed, a Flash error code is returned */
-  if (FlashStatus != FLASH_COMPLETE)
+  __set_PRIMASK(primask);
+
+  return Write;
+}
+
+/**
+  * @brief  Mark deferred variables dirty again after a failed write, they
+  *   are written by the next EE_Flush()
+  * @param  Dirty: cache indexes of the variables
+  * @param  Count: number of the variables
+  * @retval None
+  */
+static void EE_CacheMarkDirty(const int16_t* Dirty, uint16_t Count)
+{
+  uint16_t Idx;
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+
+  for (Idx = 0; Idx < Count; Idx++)
   {
-    return FlashStatus;
+    VAR_BIT_SET(VarDirty, Dirty[Idx]);
   }
 
-  /* Return last operation flash status */
-  return FlashStatus;
+  __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  Writes the records as one transaction, a single record is written
+  *   without markers. Page transfer takes place before the transaction if it
+  *   does not fit to the page.
+  * @param  Records: records to be written
+  * @param  Count: number of records
+  * @retval Success or error status:
+  *           - FLASH_COMPLETE: on success
+  *           - PAGE_FULL: if valid page is full
+  *           - NO_VALID_PAGE: if no valid page was found
+  *           - Flash error code: on write Flash error
+  */
+static uint16_t EE_WriteGroup(const ee_record_t* Records, uint16_t Count)
+{
+  uint16_t Idx, Status;
+
+  /* One record is written atomically */
+  if (Count <= 1)
+  {
+    return Count ? EE_WriteRecord(Records[0].VirtAddress, Records[0].Data) : FLASH_COMPLETE;
+  }
+
+  /* Page transfer can not take place inside of the transaction, it must
+     fit with its markers to the page */
+  if (EE_FreeRecords() < (Count + 3))
+  {
+    Status = EE_PageTransfer(NO_VIRT_ADDRESS, 0);
+    if (Status != FLASH_COMPLETE)
+    {
+      return Status;
+    }
+  }
+
+  Status = EE_VerifyPageFullWriteVariable(TXN_BEGIN_VIRT_ADDR, Count);
+
+  for (Idx = 0; (Idx < Count) && (Status == FLASH_COMPLETE); Idx++)
+  {
+    Status = EE_VerifyPageFullWriteVariable(Records[Idx].VirtAddress, Records[Idx].Data);
+  }
+
+  if (Status == FLASH_COMPLETE)
+  {
+    Status = EE_VerifyPageFullWriteVariable(TXN_COMMIT_VIRT_ADDR, Count);
+  }
+
+  if (Status != FLASH_COMPLETE)
+  {
+    /* Discard the records written so far (if the marker can be written) */
+    EE_VerifyPageFullWriteVariable(TXN_ABORT_VIRT_ADDR, 0);
+    return Status;
+  }
+
+  for (Idx = 0; Idx < Count; Idx++)
+  {
+    EE_CacheUpdate(Records[Idx].VirtAddress, Records[Idx].Data);
+  }
+
+  return FLASH_COMPLETE;
+}
+
+/**
+  * @brief  Writes a group of deferred variables, they are marked dirty again
+  *   if the write fails.
+  * @param  Records: records to be written
+  * @param  Dirty: cache indexes of the records
+  * @param  Count: number of records
+  * @retval Status of EE_WriteGroup()
+  */
+static uint16_t EE_FlushGroup(const ee_record_t* Records, const int16_t* Dirty, uint16_t Count)
+{
+  uint16_t Status = EE_WriteGroup(Records, Count);
+
+  if (Status != FLASH_COMPLETE)
+  {
+    EE_CacheMarkDirty(Dirty, Count);
+  }
+
+  return Status;
+}
+
+/**
+  * @brief  Update the RAM shadow after the variable was written to the flash
+  * @param  VirtAddress: 16 bit virtual address of the variable
+  * @param  Data: 16 bit value of the variable
+  * @retval None
+  */
+static void EE_CacheUpdate(uint16_t VirtAddress, uint16_t Data)
+{
+  int16_t VarIdx = EE_FindVarIndex(VirtAddress);
+  uint32_t primask;
+
+  if (VarIdx >= 0)
+  {
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    /* Deferred value is newer than the one in the flash */
+    if (!VAR_BIT_GET(VarDirty, VarIdx))
+    {
+      VarCache[VarIdx] = Data;
+      VAR_BIT_SET(VarFound, VarIdx);
+    }
+
+    __set_PRIMASK(primask);
+  }
+}
+
+/**
+  * @brief  Read the last values of all variables from the valid page to RAM.
+  *   Records of a transaction are taken when its commit marker is found.
+  * @param  None
+  * @retval 1 if the page ends with a transaction without commit, 0 otherwise
+  */
+static uint8_t EE_BuildCache(void)
+{
+  uint16_t ValidPage, Idx, VirtAddress;
+  uint32_t Address, PageEndAddress, TxnAddress = 0, TxnRecord;
+
+  CacheValid = 0;
+
+  for (Idx = 0; Idx < sizeof(VarFound); Idx++)
+  {
+    VarFound[Idx] = 0;
+    VarDirty[Idx] = 0;
+  }
+
+  ValidPage = EE_FindValidPage(READ_FROM_VALID_PAGE);
+
+  /* Only a valid page can be cached */
+  if (ValidPage == NO_VALID_PAGE)
+  {
+    return 0;
+  }
+
+  Address = (uint32_t)(EEPROM_START_ADDRESS + (uint32_t)(ValidPage * PAGE_SIZE)) + 4;
+  PageEndAddress = (uint32_t)((EEPROM_START_ADDRESS - 2) + (uint32_t)((1 + ValidPage) * PAGE_SIZE));
+
+  /* Records are written in order, so the later one wins */
+  while (Address < PageEndAddress)
+  {
+    if ((*(__IO uint32_t*)Address) == 0xFFFFFFFF)
+    {
+      /* The rest of the page is free */
+      break;
+    }
+
+    VirtAddress = *(__IO uint16_t*)(Address + 2);
+
+    if (VirtAddress == TXN_BEGIN_VIRT_ADDR)
+    {
+      /* Records of the transaction follow (the unfinished one is dropped) */
+      TxnAddress = Address + 4;
+    }
+    else if (VirtAddress == TXN_COMMIT_VIRT_ADDR)
+    {
+      /* Take the transaction if all its records are there */
+      if (TxnAddress && (((Address - TxnAddress) / 4) == (*(__IO uint16_t*)Address)))
+      {
+        for (TxnRecord = TxnAddress; TxnRecord < Address; TxnRecord += 4)
+        {
+          EE_CacheUpdate(*(__IO uint16_t*)(TxnRecord + 2), *(__IO uint16_t*)TxnRecord);
+        }
+      }
+
+      TxnAddress = 0;
+    }
+    else if (VirtAddress == TXN_ABORT_VIRT_ADDR)
+    {
+      TxnAddress = 0;
+    }
+    /* Record without virtual address was not completed */
+    else if (!TxnAddress && (VirtAddress != NO_VIRT_ADDRESS))
+    {
+      EE_CacheUpdate(VirtAddress, *(__IO uint16_t*)Address);
+    }
+
+    Address = Address + 4;
+  }
+
+  NextFreePage = ValidPage;
+  NextFreeAddress = Address;
+  CacheValid = 1;
+
+  return (TxnAddress != 0);
 }
 
 /**
@@ -38,20 +38,49 @@
 /* Define the size of the sectors to be used */
 #define PAGE_SIZE             ((uint32_t)0x0400)  /* Page size = 1KByte */
 
-#define EEPROM_START_ADDRESS  ((uint32_t)0x0800F800) /* EEPROM emulation start address:
-                                                        after 62KByte of used
-                                                        Flash memory */
-
-/* Pages 0 and 1 base and end addresses */
-#define PAGE0_BASE_ADDRESS    ((uint32_t)(EEPROM_START_ADDRESS + 0x0000))
-#define PAGE0_END_ADDRESS     ((uint32_t)(EEPROM_START_ADDRESS + (PAGE_SIZE - 1)))
-
-#define PAGE1_BASE_ADDRESS    ((uint32_t)(EEPROM_START_ADDRESS + 0x0400))
-#define PAGE1_END_ADDRESS     ((uint32_t)(EEPROM_START_ADDRESS + (2 * PAGE_SIZE - 1)))
+/* Number of pages used as a ring, the last two pages were used by the two
+   pages emulation (their data is taken over). The bootloader shares the
+   EEPROM, so the ring is used only if the bootloader knows it, otherwise
+   the last two pages are used in the layout of the two pages emulation. */
+#define EE_PAGE_COUNT         4
+
+/* The EEPROM pages are the last ones of the flash (the two pages layout
+   must stay at its place), they must not reach the application which ends
+   at 0x0800EFFF (linker script, USER_FLASH_END_ADDRESS of the bootloader).
+   Plain numbers, they are checked by the preprocessor. */
+#define EE_FLASH_END          0x08010000
+#define EE_FLASH_START_MIN    0x0800F000
+#define EE_FLASH_START        (EE_FLASH_END - EE_PAGE_COUNT * 0x0400)
+
+#define EEPROM_START_ADDRESS  ((uint32_t)EE_FLASH_START) /* EEPROM emulation start address:
+                                                           after 60KByte of used
+                                                           Flash memory */
+
+/* Features of the bootloader, the magic and the feature bits follow its
+   version (older bootloaders have code there) */
+#define BOOT_FEATURES_ADDRESS ((uint32_t)0x080000D4)
+#define BOOT_FEATURES_MAGIC   ((uint32_t)0x5EA7B007)
+#define BOOT_FEATURE_EE_RING  ((uint32_t)0x00000001) /* EEPROM ring of EE_PAGE_COUNT pages */
+#define BOOT_FEATURE_IWDG     ((uint32_t)0x00000002) /* bootloader reloads independent watchdog */
+#define BOOT_FEATURE_NOINIT   ((uint32_t)0x00000004) /* bootloader keeps the noinit RAM layout */
+
+#define BOOT_HAS_FEATURE(feature) \
+  ((*(__IO uint32_t*)BOOT_FEATURES_ADDRESS == BOOT_FEATURES_MAGIC) && \
+   (*(__IO uint32_t*)(BOOT_FEATURES_ADDRESS + 4) & (feature)))
+
+#if EE_PAGE_COUNT < 3
+#error "EEPROM emulation needs at least 3 pages"
+#endif
+
+#if EE_FLASH_START < EE_FLASH_START_MIN
+#error "EEPROM emulation pages overlap the application"
+#endif
+
+/* Page base address */
+#define EE_PAGE_ADDRESS(page) ((uint32_t)(EEPROM_START_ADDRESS + (uint32_t)(page) * PAGE_SIZE))
 
 /* Used Flash pages for EEPROM emulation */
 #define PAGE0                 ((uint16_t)0x0000)
-#define PAGE1                 ((uint16_t)0x0001)
 
 /* No valid page define */
 #define NO_VALID_PAGE         ((uint16_t)0x00AB)
@@ -68,11 +97,30 @@
 /* Page full define */
 #define PAGE_FULL             ((uint8_t)0x80)
 
-/* Variables' number */
-#define NB_OF_VAR             ((uint8_t)0x02)
+/* Number of records (16 bit variables) taken by a key */
+#define EE_RECORDS_16         1
+#define EE_RECORDS_32         2
+#define EE_RECORDS_BLOB(size) (1 + ((size) + 1) / 2) /* length and data */
+
+#define RESET_COUNT_NUM       8
+
+/* Saved LED configuration: brightness, mode/state masks and colours */
+#define LED_PROFILE_SIZE      44
 
+/* Maximal number of variables written by one transaction */
+#define EE_TXN_MAX_RECORDS    32
+
+/* Variables' number - records of all keys registered in eeprom.c */
+#define NB_OF_VAR             (3 * EE_RECORDS_16 + RESET_COUNT_NUM * EE_RECORDS_16 + \
+                               EE_RECORDS_BLOB(LED_PROFILE_SIZE))
+
+/* Keys, a key of more records takes also the following virtual addresses */
 enum virt_address {
     WDG_VIRT_ADDR           = 0x6666,
+    WDG_TIMEOUT_VIRT_ADDR   = 0x6667,
+    /* 0x6668 was counter of watchdog resets, records can be still in flash */
+    RESET_COUNT_VIRT_ADDR   = 0x6670, /* RESET_COUNT_NUM counters of reset causes */
+    LED_PROFILE_VIRT_ADDR   = 0x6680, /* blob of LED_PROFILE_SIZE bytes */
     RESET_VIRT_ADDR         = 0x8888
 };
 
@@ -81,15 +129,31 @@ typedef enum eeprom_var {
     VAR_FOUND           = 0,
     VAR_NO_VALID_PAGE   = NO_VALID_PAGE,
     VAR_FLASH_COMPLETE  = FLASH_COMPLETE,
-    VAR_PAGE_FULL       = PAGE_FULL
+    VAR_PAGE_FULL       = PAGE_FULL,
+    VAR_BAD_KEY         = 0x81 /* key is not registered or value is too big */
 }eeprom_var_t;
 
 /* Exported types ------------------------------------------------------------*/
+/* Variable written by a transaction */
+typedef struct ee_record {
+    uint16_t VirtAddress;
+    uint16_t Data;
+} ee_record_t;
+
 /* Exported macro ------------------------------------------------------------*/
 /* Exported functions ------------------------------------------------------- */
 uint16_t EE_Init(void);
 uint16_t EE_ReadVariable(uint16_t VirtAddress, uint16_t* Data);
 uint16_t EE_WriteVariable(uint16_t VirtAddress, uint16_t Data);
+uint16_t EE_WriteVariableDeferred(uint16_t VirtAddress, uint16_t Data);
+uint16_t EE_Flush(uint32_t QuietTime);
+uint16_t EE_WriteTransaction(const ee_record_t* Records, uint16_t Count);
+uint16_t EE_ReadVariable32(uint16_t VirtAddress, uint32_t* Data);
+uint16_t EE_WriteVariable32(uint16_t VirtAddress, uint32_t Data);
+uint16_t EE_ReadBlob(uint16_t VirtAddress, uint8_t* Data, uint16_t Size, uint16_t* Length);
+uint16_t EE_WriteBlob(uint16_t VirtAddress, const uint8_t* Data, uint16_t Length);
+uint16_t EE_Maintenance(void);
+uint16_t EE_GetEraseCount(uint16_t Page);
 
 #endif /* __EEPROM_H */
 
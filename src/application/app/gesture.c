@@ -0,0 +1,213 @@
+/**
+ ******************************************************************************
+ * @file    gesture.c
+ * @author  CZ.NIC, z.s.p.o.
+ * @date    18-October-2026
+ * @brief   Recognition of front button gestures (short and long press,
+ *          multiple clicks) from the debounced button state. Events are
+ *          queued for the main CPU in user button mode.
+ ******************************************************************************
+ ******************************************************************************
+ **/
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f0xx.h"
+#include "gesture.h"
+#include "debounce.h"
+#include "delay.h"
+
+#define GESTURE_TICK                5   /* ms, period of debounce timer */
+#define GESTURE_QUEUE_SIZE          8   /* power of 2 */
+#define GESTURE_MAX_CLICKS          3
+#define GESTURE_MAX_DURATION        0xFFFF
+
+typedef enum gesture_states {
+    GESTURE_IDLE,
+    GESTURE_PRESSED,                /* pressed, shorter than long press */
+    GESTURE_HOLD,                   /* pressed, long press reported */
+    GESTURE_WAIT_CLICK,             /* released, waiting for next click */
+} gesture_state_t;
+
+static struct st_gesture_event queue[GESTURE_QUEUE_SIZE];
+static volatile uint8_t queue_head, queue_tail;
+
+static gesture_state_t state;
+static uint16_t state_time;         /* time in the current state [ms] */
+static uint8_t clicks;
+static uint16_t click_time;         /* duration of the last click [ms] */
+static uint16_t long_press_time = GESTURE_DEFAULT_LONG_PRESS;
+static uint16_t click_gap_time = GESTURE_DEFAULT_CLICK_GAP;
+
+/*******************************************************************************
+  * @function   gesture_push
+  * @brief      Store a new event, the oldest one is lost if the queue is full.
+  *             Events are stored in user button mode only.
+  * @param      type: type of the event.
+  * @param      duration: press duration [ms].
+  * @retval     None.
+  *****************************************************************************/
+static void gesture_push(gesture_type_t type, uint16_t duration)
+{
+    struct st_gesture_event *event;
+    uint32_t primask = __get_PRIMASK();
+
+    if (button_front.button_mode != BUTTON_USER)
+        return;
+
+    /* I2C interrupt takes events out with higher priority */
+    __disable_irq();
+
+    event = &queue[queue_head & (GESTURE_QUEUE_SIZE - 1)];
+    event->type = type;
+    event->duration = duration;
+    event->timestamp = delay_get_uptime();
+
+    queue_head++;
+
+    if ((uint8_t)(queue_head - queue_tail) > GESTURE_QUEUE_SIZE)
+        queue_tail++;
+
+    __set_PRIMASK(primask);
+}
+
+/*******************************************************************************
+  * @function   gesture_push_clicks
+  * @brief      Report collected clicks.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+static void gesture_push_clicks(void)
+{
+    if (clicks)
+        gesture_push(GESTURE_SHORT_PRESS + clicks - 1, click_time);
+
+    clicks = 0;
+}
+
+/*******************************************************************************
+  * @function   gesture_update
+  * @brief      Evaluate debounced state of the button. Called every 5 ms in
+  *             debounce timer interrupt.
+  * @param      pressed: 1 - button is pressed.
+  * @retval     None.
+  *****************************************************************************/
+void gesture_update(uint8_t pressed)
+{
+    if (state_time <= GESTURE_MAX_DURATION - GESTURE_TICK)
+        state_time += GESTURE_TICK;
+
+    switch (state)
+    {
+        case GESTURE_IDLE:
+        {
+            if (pressed)
+            {
+                state = GESTURE_PRESSED;
+                state_time = 0;
+            }
+        } break;
+
+        case GESTURE_PRESSED:
+        {
+            if (!pressed)
+            {
+                if (clicks < GESTURE_MAX_CLICKS)
+                    clicks++;
+
+                click_time = state_time;
+
+                state = GESTURE_WAIT_CLICK;
+                state_time = 0;
+            }
+            else if (state_time >= long_press_time)
+            {
+                /* clicks before the long press are reported separately */
+                gesture_push_clicks();
+                gesture_push(GESTURE_LONG_PRESS, state_time);
+                state = GESTURE_HOLD;
+            }
+        } break;
+
+        case GESTURE_HOLD:
+        {
+            if (!pressed)
+            {
+                gesture_push(GESTURE_HOLD_RELEASE, state_time);
+                state = GESTURE_IDLE;
+            }
+        } break;
+
+        case GESTURE_WAIT_CLICK:
+        {
+            if (pressed)
+            {
+                state = GESTURE_PRESSED;
+                state_time = 0;
+            }
+            else if ((state_time >= click_gap_time) ||
+                     (clicks >= GESTURE_MAX_CLICKS))
+            {
+                gesture_push_clicks();
+                state = GESTURE_IDLE;
+            }
+        } break;
+    }
+}
+
+/*******************************************************************************
+  * @function   gesture_set_timing
+  * @brief      Set time thresholds of the gesture recognition.
+  * @param      long_press: minimal duration of long press [ms].
+  * @param      click_gap: maximal gap between clicks of multiple click [ms].
+  * @retval     None.
+  *****************************************************************************/
+void gesture_set_timing(uint16_t long_press, uint16_t click_gap)
+{
+    if (long_press)
+        long_press_time = long_press;
+
+    if (click_gap)
+        click_gap_time = click_gap;
+}
+
+/*******************************************************************************
+  * @function   gesture_get_event
+  * @brief      Take the oldest event from the queue.
+  * @param      event: event, type is GESTURE_NONE if the queue is empty.
+  * @retval     Number of events left in the queue.
+  *****************************************************************************/
+uint8_t gesture_get_event(struct st_gesture_event *event)
+{
+    uint8_t pending;
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+
+    if (queue_head != queue_tail)
+    {
+        *event = queue[queue_tail & (GESTURE_QUEUE_SIZE - 1)];
+        queue_tail++;
+    }
+    else
+    {
+        event->type = GESTURE_NONE;
+        event->duration = 0;
+        event->timestamp = 0;
+    }
+
+    pending = queue_head - queue_tail;
+
+    __set_PRIMASK(primask);
+
+    return pending;
+}
+
+/*******************************************************************************
+  * @function   gesture_pending
+  * @brief      Check the event queue.
+  * @param      None.
+  * @retval     Number of events in the queue.
+  *****************************************************************************/
+uint8_t gesture_pending(void)
+{
+    return queue_head - queue_tail;
+}
@@ -0,0 +1,65 @@
+/**
+ ******************************************************************************
+ * @file    gesture.h
+ * @author  CZ.NIC, z.s.p.o.
+ * @date    18-October-2026
+ * @brief   Header file for gesture.c
+ ******************************************************************************
+ ******************************************************************************
+ **/
+#ifndef GESTURE_H
+#define GESTURE_H
+
+#define GESTURE_DEFAULT_LONG_PRESS      1000 /* ms */
+#define GESTURE_DEFAULT_CLICK_GAP       300  /* ms */
+
+typedef enum gesture_types {
+    GESTURE_NONE            = 0, /* queue is empty */
+    GESTURE_SHORT_PRESS     = 1,
+    GESTURE_DOUBLE_CLICK    = 2,
+    GESTURE_TRIPLE_CLICK    = 3,
+    GESTURE_LONG_PRESS      = 4, /* long press threshold reached, still held */
+    GESTURE_HOLD_RELEASE    = 5, /* button released after long press */
+} gesture_type_t;
+
+struct st_gesture_event {
+    gesture_type_t type;
+    uint16_t duration;          /* press duration [ms] */
+    uint32_t timestamp;         /* uptime of the event [ms] */
+};
+
+/*******************************************************************************
+  * @function   gesture_update
+  * @brief      Evaluate debounced state of the button. Called every 5 ms in
+  *             debounce timer interrupt.
+  * @param      pressed: 1 - button is pressed.
+  * @retval     None.
+  *****************************************************************************/
+void gesture_update(uint8_t pressed);
+
+/*******************************************************************************
+  * @function   gesture_set_timing
+  * @brief      Set time thresholds of the gesture recognition.
+  * @param      long_press: minimal duration of long press [ms].
+  * @param      click_gap: maximal gap between clicks of multiple click [ms].
+  * @retval     None.
+  *****************************************************************************/
+void gesture_set_timing(uint16_t long_press, uint16_t click_gap);
+
+/*******************************************************************************
+  * @function   gesture_get_event
+  * @brief      Take the oldest event from the queue.
+  * @param      event: event, type is GESTURE_NONE if the queue is empty.
+  * @retval     Number of events left in the queue.
+  *****************************************************************************/
+uint8_t gesture_get_event(struct st_gesture_event *event);
+
+/*******************************************************************************
+  * @function   gesture_pending
+  * @brief      Check the event queue.
+  * @param      None.
+  * @retval     Number of events in the queue.
+  *****************************************************************************/
+uint8_t gesture_pending(void);
+
+#endif /* GESTURE_H */
@@ -12,6 +12,9 @@
 #include "led_driver.h"
 #include "delay.h"
 #include "power_control.h"
+#include "sw_timer.h"
+#include "app.h"
+#include "eeprom.h"
 
 #define NULL ((void *)0)
 #define __packed                    __attribute__((packed))
@@ -55,6 +58,7 @@
 #define MAX_LED_BRIGHTNESS          100
 #define MAX_BRIGHTNESS_STEPS        8
 #define EFFECT_TIMEOUT              5
+#define EFFECT_STEP_PERIOD          67 /* ms */
 
 /*******************************************************************************
 // PWM Settings (Frequency and range)
@@ -123,16 +127,20 @@ uint16_t leds_color_correction;
 struct led leds[LED_COUNT];
 
 static uint16_t leds_pwm_brightness;
+static struct sw_timer effect_timer;
 
 /* flag is set when LED effect after reset is
    finished and normal operation can take the LED control */
 uint8_t effect_reset_finished;
 
+/* the effect after reset ended, the saved profile is applied in main context */
+static volatile uint8_t effect_profile_pending;
+
 /* values for LED brightness [%] */
 static const uint16_t brightness_value[] = {100, 70, 40, 25, 12, 5, 1, 0};
 
 /* Private functions ---------------------------------------------------------*/
-static void led_timer_config_knight_rider(void);
+static void led_reset_effect_timer_handler(void);
 
 static void led_spi_config(void)
 {
@@ -626,6 +634,108 @@ static void led_init_led(void)
 	led_set_colour_all(WHITE_COLOUR);
 }
 
+/*
+ * LED profile stored in EEPROM (little-endian):
+ *  Byte Nr. |   Meanings
+ * -----------------
+ *      0   |   brightness [%]
+ *      1   |   version of the layout (LED_PROFILE_VERSION)
+ *   2..3   |   leds_user_mode
+ *   4..5   |   leds_state_user
+ *   6..7   |   leds_color_correction
+ *  8..43   |   RED, GREEN, BLUE of LED0..LED11
+ */
+#define LED_PROFILE_VERSION         1
+#define LED_PROFILE_COLOURS         8
+
+#if LED_PROFILE_SIZE != (LED_PROFILE_COLOURS + 3 * LED_COUNT)
+#error "LED_PROFILE_SIZE does not match the layout"
+#endif
+
+/*******************************************************************************
+  * @function   led_restore_profile
+  * @brief      Set LEDs according to the profile saved in EEPROM, if any.
+  * @param      brightness: restore also the brightness.
+  * @retval     None.
+  *****************************************************************************/
+static void led_restore_profile(int brightness)
+{
+	uint8_t profile[LED_PROFILE_SIZE];
+	const uint8_t *colour = &profile[LED_PROFILE_COLOURS];
+	uint16_t length;
+	struct led *led;
+	int i;
+
+	if (EE_ReadBlob(LED_PROFILE_VIRT_ADDR, profile, sizeof(profile),
+			&length) != VAR_FOUND)
+		return;
+
+	if ((length != LED_PROFILE_SIZE) ||
+	    (profile[1] != LED_PROFILE_VERSION))
+		return;
+
+	leds_user_mode = (profile[2] | (profile[3] << 8)) & 0xfff;
+	leds_state_user = (profile[4] | (profile[5] << 8)) & 0xfff;
+	leds_color_correction = (profile[6] | (profile[7] << 8)) & 0xfff;
+	leds_state = leds_state_user & leds_user_mode;
+
+	for (i = 0, led = leds; i < LED_COUNT; ++i, ++led, colour += 3)
+		_led_set_colour(led, (colour[0] << 16) | (colour[1] << 8) |
+				colour[2], leds_color_correction & BIT(i));
+
+	if (brightness)
+		led_pwm_set_brightness(profile[0]);
+}
+
+/*******************************************************************************
+  * @function   led_save_profile
+  * @brief      Save current colours, modes, states and brightness of LEDs to
+  *             EEPROM, they are restored after reset. Main context only.
+  * @param      None.
+  * @retval     Status of EE_WriteBlob().
+  *****************************************************************************/
+uint16_t led_save_profile(void)
+{
+	uint8_t profile[LED_PROFILE_SIZE];
+	uint8_t *colour = &profile[LED_PROFILE_COLOURS];
+	struct led *led;
+	int i;
+
+	/* take a consistent snapshot, I2C commands change LEDs in interrupt */
+	__disable_irq();
+
+	profile[0] = leds_pwm_brightness;
+	profile[1] = LED_PROFILE_VERSION;
+	profile[2] = leds_user_mode & 0xFF;
+	profile[3] = leds_user_mode >> 8;
+	profile[4] = leds_state_user & 0xFF;
+	profile[5] = leds_state_user >> 8;
+	profile[6] = leds_color_correction & 0xFF;
+	profile[7] = leds_color_correction >> 8;
+
+	for (i = 0, led = leds; i < LED_COUNT; ++i, ++led, colour += 3) {
+		colour[0] = led->chan[0];
+		colour[1] = led->chan[1];
+		colour[2] = led->chan[2];
+	}
+
+	__enable_irq();
+
+	/* the whole profile is one blob, so it is written atomically */
+	return EE_WriteBlob(LED_PROFILE_VIRT_ADDR, profile, sizeof(profile));
+}
+
+/*******************************************************************************
+  * @function   led_clear_profile
+  * @brief      Forget the saved profile, LEDs start with defaults after reset.
+  * @param      None.
+  * @retval     Status of EE_WriteBlob().
+  *****************************************************************************/
+uint16_t led_clear_profile(void)
+{
+	return EE_WriteBlob(LED_PROFILE_VIRT_ADDR, NULL, 0);
+}
+
 /*******************************************************************************
   * @function   led_config
   * @brief      Configure LED driver.
@@ -644,8 +754,11 @@ void led_config(void)
 	/* 100% brightness after reset */
 	led_pwm_set_brightness(MAX_LED_BRIGHTNESS);
 
+	/* saved profile replaces the defaults before the first frame */
+	led_restore_profile(1);
+
 	led_timer_config();
-	led_timer_config_knight_rider();
+	sw_timer_init(&effect_timer, led_reset_effect_timer_handler);
 }
 
 /*******************************************************************************
@@ -786,58 +899,46 @@ void led_double_knight_rider_effect(void)
 }
 
 /*******************************************************************************
-  * @function   led_timer_config_knight_rider
-  * @brief      Timer config for knight rider effect after reset.
-  * @param      None.
+  * @function   led_reset_effect
+  * @brief      Enable/Disable knight rider effect after reset.
+  * @param      state: ENABLE or DISABLE.
   * @retval     None.
   *****************************************************************************/
-static void led_timer_config_knight_rider(void)
+void led_reset_effect(FunctionalState state)
 {
-	TIM_TimeBaseInitTypeDef  TIM_TimeBaseStructure;
-	NVIC_InitTypeDef NVIC_InitStructure;
-
-	RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM6, DISABLE);
-	TIM_DeInit(LED_EFFECT_TIMER);
-
-	/* Clock enable */
-	RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM6, ENABLE);
-
-	/* Time base configuration */
-	TIM_TimeBaseStructure.TIM_Period = 8000 - 1;
-	TIM_TimeBaseStructure.TIM_Prescaler = 400 - 1;
-	TIM_TimeBaseStructure.TIM_ClockDivision = 0;
-	TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
-	TIM_TimeBaseInit(LED_EFFECT_TIMER, &TIM_TimeBaseStructure);
-
-	TIM_ARRPreloadConfig(LED_EFFECT_TIMER, ENABLE);
-	/* TIM Interrupts enable */
-	TIM_ITConfig(LED_EFFECT_TIMER, TIM_IT_Update, ENABLE);
-
-	/* TIM enable counter */
-	/* TIM_Cmd(LED_EFFECT_TIMER, ENABLE); */
-
-	/* Timer is enable after reset */
+	if (state == ENABLE)
+		sw_timer_start(&effect_timer, EFFECT_STEP_PERIOD, EFFECT_STEP_PERIOD);
+	else
+		sw_timer_stop(&effect_timer);
+}
 
-	NVIC_InitStructure.NVIC_IRQChannel = TIM6_DAC_IRQn;
-	NVIC_InitStructure.NVIC_IRQChannelPriority = 0x05;
-	NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
-	NVIC_Init(&NVIC_InitStructure);
+/*******************************************************************************
+  * @function   led_reset_effect_timer_handler
+  * @brief      Effect timer callback, one step of the effect after reset.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+static void led_reset_effect_timer_handler(void)
+{
+	led_knight_rider_effect_handler();
+	app_post_event(APP_EVENT_LED);
 }
 
 /*******************************************************************************
-  * @function   led_reset_effect
-  * @brief      Enable/Disable knight rider effect after reset.
-  * @param      colour: colour in RGB range.
+  * @function   led_finish_reset_effect
+  * @brief      Apply the saved profile after the effect after reset (the
+  *             brightness is kept). Main context only, the profile is read
+  *             from EEPROM and its write must not be in progress.
+  * @param      None.
   * @retval     None.
   *****************************************************************************/
-void led_reset_effect(FunctionalState state)
+void led_finish_reset_effect(void)
 {
-	if (state == ENABLE) {
-		TIM_Cmd(LED_EFFECT_TIMER, ENABLE);
-	} else {
-		TIM_Cmd(LED_EFFECT_TIMER, DISABLE);
-		LED_EFFECT_TIMER->CNT = 0;
-	}
+	if (!effect_profile_pending)
+		return;
+
+	effect_profile_pending = 0;
+	led_restore_profile(0);
 }
 
 static const struct led_pattern_info knight_rider_pattern = {
@@ -851,8 +952,8 @@ static const struct led_pattern_info knight_rider_pattern = {
 
 /*******************************************************************************
   * @function   led_knight_rider_effect_handler
-  * @brief      Display knight rider effect on LEDs during startup (called in
-  *             timer interrupt).
+  * @brief      Display knight rider effect on LEDs during startup (called
+  *             from effect timer).
   * @param      None.
   * @retval     None.
   *****************************************************************************/
@@ -865,6 +966,7 @@ void led_knight_rider_effect_handler(void)
 	switch (effect_state) {
 	case EFFECT_INIT:
 		effect_reset_finished = RESET;
+		effect_profile_pending = 0;
 		led_set_state_all(1);
 		led_set_colour_all(0x0);
 //		led_set_color_correction_all(1);
@@ -903,6 +1005,8 @@ void led_knight_rider_effect_handler(void)
 			led_set_colour_all(WHITE_COLOUR);
 
 			led_set_user_mode_all(0);
+			/* back to the saved profile by led_finish_reset_effect() */
+			effect_profile_pending = 1;
 			led_reset_effect(DISABLE);
 			state_timeout_cnt = 0;
 			effect_reset_finished = SET;
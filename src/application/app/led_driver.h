@@ -15,7 +15,6 @@
 #define BIT(b)                    (1 << (b))
 
 #define LED_TIMER                 TIM3
-#define LED_EFFECT_TIMER          TIM6
 
 #define LED_COUNT                 12
 
@@ -72,6 +71,9 @@ void led_pwm_set_brightness(uint16_t procent_val);
 uint16_t led_pwm_get_brightness(void);
 void led_step_brightness(void);
 
+uint16_t led_save_profile(void);
+uint16_t led_clear_profile(void);
+
 void led_set_colour(int led, uint32_t colour);
 void led_set_colour_all(uint32_t colour);
 void led_compute_levels(int led, int color_correction);
@@ -181,5 +183,6 @@ void led_knight_rider_colour_effect(void);
 void led_double_knight_rider_effect(void);
 void led_knight_rider_effect_handler(void);
 void led_reset_effect(FunctionalState state);
+void led_finish_reset_effect(void);
 
 #endif /*__LED_DRIVER_H */
@@ -13,6 +13,8 @@
 #include "delay.h"
 #include "led_driver.h"
 #include "debug_serial.h"
+#include "sw_timer.h"
+#include "trace.h"
 
 /* Private define ------------------------------------------------------------*/
 
@@ -111,6 +113,11 @@ precise. Pulse for logic '1' or '0' takes only 1 us */
 
 #define RGB_COLOUR_LEVELS       255
 
+/* USB overcurrent recovery, times in USB_TIMEOUT_PERIOD ticks (100 ms) */
+#define USB_OVC_FIRST_RETRY     10  /* 1 sec, doubled after each retry */
+#define USB_OVC_MAX_RETRIES     5   /* 1+2+4+8+16 sec, then lockout */
+#define USB_OVC_PROBATION_TIME  600 /* 60 sec without overcurrent */
+
 typedef enum reset_states {
     RST_INIT,
     RST_LED0,
@@ -127,6 +134,9 @@ typedef enum reset_states {
     RST_LED11,
 } reset_state_t;
 
+struct st_usb_ovc usb_ovc[USB_PORT_COUNT];
+static struct sw_timer usb_timeout_timer;
+
 /*******************************************************************************
   * @function   power_control_prog4v5_config
   * @brief      Configuration for programming possibility of 4V5 power source.
@@ -317,6 +327,8 @@ error_type_t power_control_start_regulator(reg_type_t regulator)
     error_type_t error = NO_ERROR;
     uint16_t counter = 0;
 
+    trace_event(TRACE_REG_START, regulator);
+
     switch(regulator)
     {
         case REG_5V:
@@ -454,6 +466,8 @@ error_type_t power_control_start_regulator(reg_type_t regulator)
             break;
     }
 
+    trace_event(TRACE_REG_DONE, regulator | (error << 8));
+
     return error;
 }
 
@@ -587,36 +601,13 @@ uint8_t power_control_get_usb_poweron(usb_ports_t usb_port)
 
 /*******************************************************************************
   * @function   power_control_usb_timeout_config
-  * @brief      Timer configuration for USB recovery timeout.
-  * @param      None.
+  * @brief      Software timer configuration for USB recovery timeout.
+  * @param      handler: called every USB_TIMEOUT_PERIOD while the timeout runs.
   * @retval     None.
   *****************************************************************************/
-void power_control_usb_timeout_config(void)
+void power_control_usb_timeout_config(sw_timer_callback_t handler)
 {
-    TIM_TimeBaseInitTypeDef  TIM_TimeBaseStructure;
-    NVIC_InitTypeDef NVIC_InitStructure;
-
-    RCC_APB2PeriphClockCmd(RCC_APB2Periph_TIM17, DISABLE);
-    TIM_DeInit(USB_TIMEOUT_TIMER);
-
-    /* Clock enable */
-    RCC_APB2PeriphClockCmd(RCC_APB2Periph_TIM17, ENABLE);
-
-    /* Time base configuration - 1sec interrupt */
-    TIM_TimeBaseStructure.TIM_Period = 8000 - 1;
-    TIM_TimeBaseStructure.TIM_Prescaler = 6000 - 1;
-    TIM_TimeBaseStructure.TIM_ClockDivision = 0;
-    TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
-    TIM_TimeBaseInit(USB_TIMEOUT_TIMER, &TIM_TimeBaseStructure);
-
-    TIM_ARRPreloadConfig(USB_TIMEOUT_TIMER, ENABLE);
-    /* TIM Interrupts enable */
-    TIM_ITConfig(USB_TIMEOUT_TIMER, TIM_IT_Update, ENABLE);
-
-    NVIC_InitStructure.NVIC_IRQChannel = TIM17_IRQn;
-    NVIC_InitStructure.NVIC_IRQChannelPriority = 0x05;
-    NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
-    NVIC_Init(&NVIC_InitStructure);
+    sw_timer_init(&usb_timeout_timer, handler);
 }
 
 /*******************************************************************************
@@ -627,8 +618,9 @@ void power_control_usb_timeout_config(void)
   *****************************************************************************/
 void power_control_usb_timeout_enable(void)
 {
-    /* TIM enable counter */
-    TIM_Cmd(USB_TIMEOUT_TIMER, ENABLE);
+    if (!sw_timer_is_active(&usb_timeout_timer))
+        sw_timer_start(&usb_timeout_timer, USB_TIMEOUT_PERIOD,
+                       USB_TIMEOUT_PERIOD);
 }
 
 /*******************************************************************************
@@ -639,9 +631,114 @@ void power_control_usb_timeout_enable(void)
   *****************************************************************************/
 void power_control_usb_timeout_disable(void)
 {
-    /* disable timer and set initial condition */
-    TIM_Cmd(USB_TIMEOUT_TIMER, DISABLE);
-    USB_TIMEOUT_TIMER->CNT = 0;
+    sw_timer_stop(&usb_timeout_timer);
+}
+
+/*******************************************************************************
+  * @function   power_control_usb_overcurrent
+  * @brief      Switch off the port and schedule its recovery. The delay before
+  *             the next retry is doubled each time, the port is locked out
+  *             after USB_OVC_MAX_RETRIES retries.
+  * @param      usb_port: USB3_PORT0 or USB3_PORT1.
+  * @retval     None.
+  *****************************************************************************/
+void power_control_usb_overcurrent(usb_ports_t usb_port)
+{
+    struct st_usb_ovc *ovc = &usb_ovc[usb_port];
+
+    power_control_usb(usb_port, USB_OFF);
+
+    __disable_irq();
+
+    /* port is already off, the overcurrent flag may not be released yet */
+    if ((ovc->state == USB_OVC_BACKOFF) || (ovc->state == USB_OVC_LOCKOUT))
+    {
+        __enable_irq();
+        return;
+    }
+
+    ovc->fault_count++;
+    ovc->last_fault = delay_get_uptime();
+
+    if (ovc->retries >= USB_OVC_MAX_RETRIES)
+    {
+        ovc->state = USB_OVC_LOCKOUT;
+        DBG("USB OVC lockout\r\n");
+    }
+    else
+    {
+        ovc->timeout = USB_OVC_FIRST_RETRY << ovc->retries;
+        ovc->retries++;
+        ovc->state = USB_OVC_BACKOFF;
+        power_control_usb_timeout_enable();
+    }
+
+    __enable_irq();
+}
+
+/*******************************************************************************
+  * @function   power_control_usb_recovery_reset
+  * @brief      Forget recovery state of the port. It is called when the host
+  *             switches the port on/off, so a pending retry does not override
+  *             its decision and the lockout is released.
+  * @param      usb_port: USB3_PORT0 or USB3_PORT1.
+  * @retval     None.
+  *****************************************************************************/
+void power_control_usb_recovery_reset(usb_ports_t usb_port)
+{
+    struct st_usb_ovc *ovc = &usb_ovc[usb_port];
+
+    ovc->state = USB_OVC_IDLE;
+    ovc->retries = 0;
+    ovc->timeout = 0;
+}
+
+/*******************************************************************************
+  * @function   power_control_usb_timeout_handler
+  * @brief      Advance recovery of all ports, called from USB timeout timer.
+  *             The timer is stopped when no port needs it anymore.
+  * @param      None.
+  * @retval     Bit mask of ports which have been powered on again.
+  *****************************************************************************/
+uint8_t power_control_usb_timeout_handler(void)
+{
+    struct st_usb_ovc *ovc;
+    uint8_t port, powered = 0, running = 0;
+
+    for (port = 0; port < USB_PORT_COUNT; port++)
+    {
+        ovc = &usb_ovc[port];
+
+        if ((ovc->state != USB_OVC_BACKOFF) && (ovc->state != USB_OVC_PROBATION))
+            continue;
+
+        if (ovc->timeout)
+            ovc->timeout--;
+
+        if (ovc->timeout == 0)
+        {
+            if (ovc->state == USB_OVC_BACKOFF)
+            {
+                power_control_usb(port, USB_ON);
+                powered |= 1 << port;
+                ovc->timeout = USB_OVC_PROBATION_TIME;
+                ovc->state = USB_OVC_PROBATION;
+            }
+            else /* stable long enough */
+            {
+                ovc->retries = 0;
+                ovc->state = USB_OVC_IDLE;
+            }
+        }
+
+        if (ovc->state != USB_OVC_IDLE)
+            running = 1;
+    }
+
+    if (!running)
+        power_control_usb_timeout_disable();
+
+    return powered;
 }
 
 /*******************************************************************************
@@ -670,7 +767,9 @@ reset_type_t power_control_first_startup(void)
     /* wait for main board reset signal */
     while (!GPIO_ReadInputDataBit(SYSRES_OUT_PIN_PORT, SYSRES_OUT_PIN))
     {
-        /* handle factory reset timeouts */
+        /* handle factory reset timeouts, the button can be held for
+         * several seconds */
+        delay_iwdg_reload();
         delay(RESET_STATE_READING);
         reset_cnt++;
 
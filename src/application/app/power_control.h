@@ -11,8 +11,9 @@
 #define POWER_CONTROL_H
 
 #include "stm32f0xx.h"
+#include "sw_timer.h"
 
-#define USB_TIMEOUT_TIMER                   TIM17
+#define USB_TIMEOUT_PERIOD                  100 /* ms */
 
 /* Outputs */
 #define INT_MCU_PIN_PERIPH_CLOCK            RCC_AHBPeriph_GPIOC
@@ -153,6 +154,25 @@ typedef enum usb_ports {
     USB3_PORT1 = 1
 }usb_ports_t;
 
+#define USB_PORT_COUNT                      2
+
+typedef enum usb_ovc_states {
+    USB_OVC_IDLE        = 0, /* port powered, no recent overcurrent */
+    USB_OVC_BACKOFF     = 1, /* port off, waiting for the next retry */
+    USB_OVC_PROBATION   = 2, /* port powered again, retries not forgotten yet */
+    USB_OVC_LOCKOUT     = 3, /* too many retries, port stays off */
+}usb_ovc_state_t;
+
+struct st_usb_ovc {
+    usb_ovc_state_t state;
+    uint8_t retries;            /* retries since the last stable period */
+    uint16_t timeout;           /* remaining time in USB timer ticks */
+    uint16_t fault_count;       /* overcurrents since power-up */
+    uint32_t last_fault;        /* uptime of the last overcurrent [ms] */
+};
+
+extern struct st_usb_ovc usb_ovc[USB_PORT_COUNT];
+
 typedef enum reg_types {
     REG_5V,
     REG_3V3,
@@ -234,11 +254,35 @@ reset_type_t power_control_first_startup(void);
 
 /*******************************************************************************
   * @function   power_control_usb_timeout_config
-  * @brief      Timer configuration for USB recovery timeout.
-  * @param      None.
+  * @brief      Software timer configuration for USB recovery timeout.
+  * @param      handler: called every USB_TIMEOUT_PERIOD while the timeout runs.
+  * @retval     None.
+  *****************************************************************************/
+void power_control_usb_timeout_config(sw_timer_callback_t handler);
+
+/*******************************************************************************
+  * @function   power_control_usb_overcurrent
+  * @brief      Switch off the port and schedule its recovery (or lock it out).
+  * @param      usb_port: USB3_PORT0 or USB3_PORT1.
   * @retval     None.
   *****************************************************************************/
-void power_control_usb_timeout_config(void);
+void power_control_usb_overcurrent(usb_ports_t usb_port);
+
+/*******************************************************************************
+  * @function   power_control_usb_recovery_reset
+  * @brief      Forget recovery state of the port (port was set by the host).
+  * @param      usb_port: USB3_PORT0 or USB3_PORT1.
+  * @retval     None.
+  *****************************************************************************/
+void power_control_usb_recovery_reset(usb_ports_t usb_port);
+
+/*******************************************************************************
+  * @function   power_control_usb_timeout_handler
+  * @brief      Advance recovery of all ports, called from USB timeout timer.
+  * @param      None.
+  * @retval     Bit mask of ports which have been powered on again.
+  *****************************************************************************/
+uint8_t power_control_usb_timeout_handler(void);
 
 /*******************************************************************************
   * @function   power_control_get_usb_overcurrent
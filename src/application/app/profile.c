@@ -0,0 +1,184 @@
+/**
+ ******************************************************************************
+ * @file    profile.c
+ * @author  CZ.NIC, z.s.p.o.
+ * @date    18-October-2026
+ * @brief   Run time accounting of interrupts. Cortex-M0 has no cycle counter,
+ *          so the time is taken from a free running 1 MHz timer. Time of
+ *          nested interrupts is subtracted from the interrupted one.
+ ******************************************************************************
+ ******************************************************************************
+ **/
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f0xx_conf.h"
+#include "profile.h"
+
+#define PROFILE_TIMER               TIM16
+/* one level per used interrupt priority is enough */
+#define PROFILE_MAX_NESTING         8
+
+struct st_profile {
+    uint32_t busy;              /* run time in the current window [us] */
+    uint16_t load;              /* run time in the last window [0.1 %] */
+    uint16_t max_time;          /* the longest run since start [us] */
+};
+
+static struct st_profile profile[PROFILE_COUNT];
+
+/* stack of running (nested) interrupts */
+static uint8_t run_id[PROFILE_MAX_NESTING];
+static uint16_t run_time[PROFILE_MAX_NESTING];
+static uint8_t depth;
+static uint16_t mark;           /* timer value of the last enter/exit */
+
+/*******************************************************************************
+  * @function   profile_config
+  * @brief      Start the free running 1 MHz profiling timer.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+void profile_config(void)
+{
+    TIM_TimeBaseInitTypeDef  TIM_TimeBaseStructure;
+
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_TIM16, DISABLE);
+    TIM_DeInit(PROFILE_TIMER);
+
+    /* Clock enable */
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_TIM16, ENABLE);
+
+    /* Time base configuration - 1 us tick, no interrupt */
+    TIM_TimeBaseStructure.TIM_Period = 0xFFFF;
+    TIM_TimeBaseStructure.TIM_Prescaler = SystemCoreClock / 1000000u - 1;
+    TIM_TimeBaseStructure.TIM_ClockDivision = 0;
+    TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
+    TIM_TimeBaseStructure.TIM_RepetitionCounter = 0;
+    TIM_TimeBaseInit(PROFILE_TIMER, &TIM_TimeBaseStructure);
+
+    /* TIM enable counter */
+    TIM_Cmd(PROFILE_TIMER, ENABLE);
+}
+
+/*******************************************************************************
+  * @function   profile_charge
+  * @brief      Add time since the last mark to the running interrupt.
+  *             Interrupts must be disabled.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+static void profile_charge(void)
+{
+    uint16_t now = PROFILE_TIMER->CNT;
+    uint16_t time = now - mark;
+
+    mark = now;
+
+    if (depth && (depth <= PROFILE_MAX_NESTING))
+    {
+        run_time[depth - 1] += time;
+        profile[run_id[depth - 1]].busy += time;
+    }
+}
+
+/*******************************************************************************
+  * @function   profile_enter
+  * @brief      Start accounting of an interrupt, the interrupted one is paused.
+  * @param      id: profiled interrupt.
+  * @retval     None.
+  *****************************************************************************/
+void profile_enter(profile_id_t id)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+
+    profile_charge();
+
+    if (depth < PROFILE_MAX_NESTING)
+    {
+        run_id[depth] = id;
+        run_time[depth] = 0;
+    }
+    depth++;
+
+    __set_PRIMASK(primask);
+}
+
+/*******************************************************************************
+  * @function   profile_exit
+  * @brief      Stop accounting of the current interrupt.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+void profile_exit(void)
+{
+    struct st_profile *prof;
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+
+    profile_charge();
+
+    if (depth)
+    {
+        depth--;
+
+        if (depth < PROFILE_MAX_NESTING)
+        {
+            prof = &profile[run_id[depth]];
+
+            if (run_time[depth] > prof->max_time)
+                prof->max_time = run_time[depth];
+        }
+    }
+
+    __set_PRIMASK(primask);
+}
+
+/*******************************************************************************
+  * @function   profile_update
+  * @brief      Evaluate the load at the end of a measuring window.
+  * @param      window: length of the window [ms].
+  * @retval     None.
+  *****************************************************************************/
+void profile_update(uint32_t window)
+{
+    struct st_profile *prof;
+    uint8_t idx;
+
+    if (window == 0)
+        return;
+
+    for (idx = 0; idx < PROFILE_COUNT; idx++)
+    {
+        prof = &profile[idx];
+
+        __disable_irq();
+        /* run time in 0.1 % of the window (us / ms) */
+        prof->load = prof->busy / window;
+        prof->busy = 0;
+        __enable_irq();
+    }
+}
+
+/*******************************************************************************
+  * @function   profile_get_load
+  * @brief      Load in the last window.
+  * @param      id: profiled interrupt.
+  * @retval     Run time in 0.1 % of the window.
+  *****************************************************************************/
+uint16_t profile_get_load(profile_id_t id)
+{
+    return profile[id].load;
+}
+
+/*******************************************************************************
+  * @function   profile_get_max_time
+  * @brief      The longest run since start, without nested interrupts.
+  * @param      id: profiled interrupt.
+  * @retval     Run time [us].
+  *****************************************************************************/
+uint16_t profile_get_max_time(profile_id_t id)
+{
+    return profile[id].max_time;
+}
@@ -0,0 +1,81 @@
+/**
+ ******************************************************************************
+ * @file    profile.h
+ * @author  CZ.NIC, z.s.p.o.
+ * @date    18-October-2026
+ * @brief   Header file for profile.c
+ ******************************************************************************
+ ******************************************************************************
+ **/
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#define PROFILE_ENABLE              1
+
+typedef enum profile_ids {
+    PROFILE_SYSTICK,            /* uptime and CPU watchdog */
+    PROFILE_SW_TIMERS,          /* debounce, USB timeout, LED effect */
+    PROFILE_LED,                /* LED frames and patterns (TIM3) */
+    PROFILE_I2C,                /* I2C slave */
+    PROFILE_EXTI,               /* reset inputs and PG glitches */
+    PROFILE_DMA,                /* debug serial output (DMA) */
+    PROFILE_COUNT
+} profile_id_t;
+
+#if PROFILE_ENABLE
+#define PROFILE_ENTER(id)           profile_enter(id)
+#define PROFILE_EXIT()              profile_exit()
+#else
+#define PROFILE_ENTER(id)
+#define PROFILE_EXIT()
+#endif
+
+/*******************************************************************************
+  * @function   profile_config
+  * @brief      Start the free running 1 MHz profiling timer.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+void profile_config(void);
+
+/*******************************************************************************
+  * @function   profile_enter
+  * @brief      Start accounting of an interrupt, the interrupted one is paused.
+  * @param      id: profiled interrupt.
+  * @retval     None.
+  *****************************************************************************/
+void profile_enter(profile_id_t id);
+
+/*******************************************************************************
+  * @function   profile_exit
+  * @brief      Stop accounting of the current interrupt.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+void profile_exit(void);
+
+/*******************************************************************************
+  * @function   profile_update
+  * @brief      Evaluate the load at the end of a measuring window.
+  * @param      window: length of the window [ms].
+  * @retval     None.
+  *****************************************************************************/
+void profile_update(uint32_t window);
+
+/*******************************************************************************
+  * @function   profile_get_load
+  * @brief      Load in the last window.
+  * @param      id: profiled interrupt.
+  * @retval     Run time in 0.1 % of the window.
+  *****************************************************************************/
+uint16_t profile_get_load(profile_id_t id);
+
+/*******************************************************************************
+  * @function   profile_get_max_time
+  * @brief      The longest run since start, without nested interrupts.
+  * @param      id: profiled interrupt.
+  * @retval     Run time [us].
+  *****************************************************************************/
+uint16_t profile_get_max_time(profile_id_t id);
+
+#endif /* PROFILE_H */
@@ -0,0 +1,100 @@
+/**
+ ******************************************************************************
+ * @file    ram_monitor.c
+ * @author  CZ.NIC, z.s.p.o.
+ * @date    18-October-2026
+ * @brief   Monitoring of stack usage (high-water mark of the painted stack)
+ *          and static RAM usage of modules.
+ ******************************************************************************
+ ******************************************************************************
+ **/
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f0xx.h"
+#include "ram_monitor.h"
+
+/* defined in linker script */
+extern uint32_t _sstack[], _estack[];
+extern uint8_t _sdata[], _edata[], _sbss[], _ebss[];
+extern uint8_t _sdata_app[], _sdata_led[], _sdata_i2c[], _sdata_input[],
+               _sdata_power[], _sdata_eeprom[], _sdata_other[];
+extern uint8_t _sbss_app[], _sbss_led[], _sbss_i2c[], _sbss_input[],
+               _sbss_power[], _sbss_eeprom[], _sbss_other[];
+
+/* module boundaries, the next start is the end of a module */
+static uint8_t * const data_bounds[RAM_MODULE_COUNT + 1] = {
+    _sdata_app, _sdata_led, _sdata_i2c, _sdata_input, _sdata_power,
+    _sdata_eeprom, _sdata_other, _edata
+};
+
+static uint8_t * const bss_bounds[RAM_MODULE_COUNT + 1] = {
+    _sbss_app, _sbss_led, _sbss_i2c, _sbss_input, _sbss_power,
+    _sbss_eeprom, _sbss_other, _ebss
+};
+
+/* the lowest stack word which has been used */
+static uint32_t *stack_mark = _estack;
+
+/*******************************************************************************
+  * @function   ram_monitor_scan
+  * @brief      Find the deepest stack usage so far. Only the part below the
+  *             previous mark is searched, the mark can only go down.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+void ram_monitor_scan(void)
+{
+    uint32_t *word = _sstack;
+
+    while ((word < stack_mark) && (*word == STACK_PAINT_PATTERN))
+        word++;
+
+    stack_mark = word;
+}
+
+/*******************************************************************************
+  * @function   ram_monitor_stack_size
+  * @brief      Space available for the stack.
+  * @param      None.
+  * @retval     Size in bytes.
+  *****************************************************************************/
+uint16_t ram_monitor_stack_size(void)
+{
+    return (uint8_t *)_estack - (uint8_t *)_sstack;
+}
+
+/*******************************************************************************
+  * @function   ram_monitor_stack_free
+  * @brief      Minimal free stack since start (as of the last scan).
+  * @param      None.
+  * @retval     Size in bytes.
+  *****************************************************************************/
+uint16_t ram_monitor_stack_free(void)
+{
+    return (uint8_t *)stack_mark - (uint8_t *)_sstack;
+}
+
+/*******************************************************************************
+  * @function   ram_monitor_static_size
+  * @brief      Static RAM (data and bss) used by all modules.
+  * @param      None.
+  * @retval     Size in bytes.
+  *****************************************************************************/
+uint16_t ram_monitor_static_size(void)
+{
+    return (_edata - _sdata) + (_ebss - _sbss);
+}
+
+/*******************************************************************************
+  * @function   ram_monitor_module_size
+  * @brief      Static RAM (data and bss) used by a group of modules.
+  * @param      module: group of modules.
+  * @retval     Size in bytes.
+  *****************************************************************************/
+uint16_t ram_monitor_module_size(ram_module_t module)
+{
+    if (module >= RAM_MODULE_COUNT)
+        return 0;
+
+    return (data_bounds[module + 1] - data_bounds[module]) +
+           (bss_bounds[module + 1] - bss_bounds[module]);
+}
@@ -0,0 +1,68 @@
+/**
+ ******************************************************************************
+ * @file    ram_monitor.h
+ * @author  CZ.NIC, z.s.p.o.
+ * @date    18-October-2026
+ * @brief   Header file for ram_monitor.c
+ ******************************************************************************
+ ******************************************************************************
+ **/
+#ifndef RAM_MONITOR_H
+#define RAM_MONITOR_H
+
+/* stack is painted by startup code, startup_stm32f030x8.s */
+#define STACK_PAINT_PATTERN         0xA5A5A5A5
+
+/* module groups as defined in linker script */
+typedef enum ram_modules {
+    RAM_APP,                    /* app, scheduler, timers, main */
+    RAM_LED,
+    RAM_I2C,
+    RAM_INPUT,                  /* debounce, gestures, indication inputs */
+    RAM_POWER,
+    RAM_EEPROM,
+    RAM_OTHER,                  /* libraries */
+    RAM_MODULE_COUNT
+} ram_module_t;
+
+/*******************************************************************************
+  * @function   ram_monitor_scan
+  * @brief      Find the deepest stack usage so far.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+void ram_monitor_scan(void);
+
+/*******************************************************************************
+  * @function   ram_monitor_stack_size
+  * @brief      Space available for the stack.
+  * @param      None.
+  * @retval     Size in bytes.
+  *****************************************************************************/
+uint16_t ram_monitor_stack_size(void);
+
+/*******************************************************************************
+  * @function   ram_monitor_stack_free
+  * @brief      Minimal free stack since start (as of the last scan).
+  * @param      None.
+  * @retval     Size in bytes.
+  *****************************************************************************/
+uint16_t ram_monitor_stack_free(void);
+
+/*******************************************************************************
+  * @function   ram_monitor_static_size
+  * @brief      Static RAM (data and bss) used by all modules.
+  * @param      None.
+  * @retval     Size in bytes.
+  *****************************************************************************/
+uint16_t ram_monitor_static_size(void);
+
+/*******************************************************************************
+  * @function   ram_monitor_module_size
+  * @brief      Static RAM (data and bss) used by a group of modules.
+  * @param      module: group of modules.
+  * @retval     Size in bytes.
+  *****************************************************************************/
+uint16_t ram_monitor_module_size(ram_module_t module);
+
+#endif /* RAM_MONITOR_H */
@@ -0,0 +1,161 @@
+/**
+ ******************************************************************************
+ * @file    reset_cause.c
+ * @author  CZ.NIC, z.s.p.o.
+ * @date    18-October-2026
+ * @brief   Cause of the MCU reset from RCC_CSR flags and firmware cause kept
+ *          in uninitialized RAM. Resets are counted in EEPROM per cause.
+ ******************************************************************************
+ ******************************************************************************
+ **/
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f0xx_conf.h"
+#include "reset_cause.h"
+#include "eeprom.h"
+
+#define RESET_FW_MAGIC              0x5E7CA05E
+
+struct st_fw_reset {
+    uint32_t magic;             /* RESET_FW_MAGIC - cause is valid */
+    uint32_t cause;             /* reset_fw_cause_t */
+};
+
+static struct st_fw_reset fw_reset __attribute__((section(".noinit.reset")));
+
+static uint8_t reset_flags;
+static reset_fw_cause_t reset_fw_cause;
+static uint16_t reset_counters[RESET_CAUSE_COUNT];
+
+/*******************************************************************************
+  * @function   reset_cause_capture
+  * @brief      Take and clear reset flags and firmware cause of the reset.
+  *             Called at the start of main().
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+void reset_cause_capture(void)
+{
+    struct st_fw_reset *fw = &fw_reset;
+
+    reset_flags = RCC->CSR >> 24;
+    RCC_ClearFlag();
+
+    /* firmware cause is valid only if firmware did the reset, RAM is not
+     * defined after power-on */
+    if ((fw->magic == RESET_FW_MAGIC) &&
+        (reset_flags & (RESET_FLAG_SFT | RESET_FLAG_IWDG)) &&
+        !(reset_flags & RESET_FLAG_POR))
+        reset_fw_cause = fw->cause;
+    else
+        reset_fw_cause = RESET_FW_NONE;
+
+    fw->magic = 0;
+    fw->cause = RESET_FW_NONE;
+}
+
+/*******************************************************************************
+  * @function   reset_cause_set_fw
+  * @brief      Store the firmware cause of the reset which follows.
+  * @param      cause: firmware cause.
+  * @retval     None.
+  *****************************************************************************/
+void reset_cause_set_fw(reset_fw_cause_t cause)
+{
+    struct st_fw_reset *fw = &fw_reset;
+
+    fw->cause = cause;
+    fw->magic = RESET_FW_MAGIC;
+}
+
+/*******************************************************************************
+  * @function   reset_cause_get
+  * @brief      Cause of the last reset, firmware cause takes precedence.
+  * @param      None.
+  * @retval     Cause.
+  *****************************************************************************/
+reset_cause_t reset_cause_get(void)
+{
+    switch (reset_fw_cause)
+    {
+        case RESET_FW_CPU_WATCHDOG:     return RESET_CAUSE_CPU_WATCHDOG;
+        case RESET_FW_PG_FAULT:
+        case RESET_FW_POWER_ERROR:      return RESET_CAUSE_POWER_FAULT;
+        case RESET_FW_I2C:              return RESET_CAUSE_I2C;
+        case RESET_FW_HARD_FAULT:       return RESET_CAUSE_HARD_FAULT;
+        default: break;
+    }
+
+    if (reset_flags & RESET_FLAG_IWDG)
+        return RESET_CAUSE_MCU_WATCHDOG;
+
+    /* power-on sets PIN flag too */
+    if (reset_flags & RESET_FLAG_POR)
+        return RESET_CAUSE_POWER_ON;
+
+    if (reset_flags & RESET_FLAG_PIN)
+        return RESET_CAUSE_PIN;
+
+    return RESET_CAUSE_OTHER;
+}
+
+/*******************************************************************************
+  * @function   reset_cause_count
+  * @brief      Load counters of causes from EEPROM and count the last reset.
+  *             EEPROM must be initialized.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+void reset_cause_count(void)
+{
+    reset_cause_t cause = reset_cause_get();
+    uint16_t ee_data;
+    uint8_t idx;
+
+    for (idx = 0; idx < RESET_CAUSE_COUNT; idx++)
+    {
+        if (EE_ReadVariable(RESET_COUNT_VIRT_ADDR + idx, &ee_data) == VAR_FOUND)
+            reset_counters[idx] = ee_data;
+    }
+
+    if (reset_counters[cause] < 0xFFFF)
+    {
+        reset_counters[cause]++;
+        EE_WriteVariable(RESET_COUNT_VIRT_ADDR + cause, reset_counters[cause]);
+    }
+}
+
+/*******************************************************************************
+  * @function   reset_cause_get_flags
+  * @brief      Reset flags of the last reset.
+  * @param      None.
+  * @retval     RESET_FLAG_x mask.
+  *****************************************************************************/
+uint8_t reset_cause_get_flags(void)
+{
+    return reset_flags;
+}
+
+/*******************************************************************************
+  * @function   reset_cause_get_fw
+  * @brief      Firmware cause of the last reset.
+  * @param      None.
+  * @retval     Firmware cause.
+  *****************************************************************************/
+reset_fw_cause_t reset_cause_get_fw(void)
+{
+    return reset_fw_cause;
+}
+
+/*******************************************************************************
+  * @function   reset_cause_get_counter
+  * @brief      Number of resets with the cause (saturated).
+  * @param      cause: cause.
+  * @retval     Counter.
+  *****************************************************************************/
+uint16_t reset_cause_get_counter(reset_cause_t cause)
+{
+    if (cause >= RESET_CAUSE_COUNT)
+        return 0;
+
+    return reset_counters[cause];
+}
@@ -0,0 +1,104 @@
+/**
+ ******************************************************************************
+ * @file    reset_cause.h
+ * @author  CZ.NIC, z.s.p.o.
+ * @date    18-October-2026
+ * @brief   Header file for reset_cause.c
+ ******************************************************************************
+ ******************************************************************************
+ **/
+#ifndef RESET_CAUSE_H
+#define RESET_CAUSE_H
+
+/* reset flags of RCC_CSR (bits 24..31) */
+#define RESET_FLAG_OBL              0x02 /* option byte loader */
+#define RESET_FLAG_PIN              0x04 /* NRST pin */
+#define RESET_FLAG_POR              0x08 /* power-on / power-down */
+#define RESET_FLAG_SFT              0x10 /* software reset */
+#define RESET_FLAG_IWDG             0x20 /* independent watchdog */
+#define RESET_FLAG_WWDG             0x40 /* window watchdog */
+#define RESET_FLAG_LPWR             0x80 /* low-power */
+
+/* reason of a reset requested by firmware, kept in RAM over the reset */
+typedef enum reset_fw_causes {
+    RESET_FW_NONE           = 0,
+    RESET_FW_CPU_WATCHDOG   = 1, /* CPU did not stop the watchdog in time */
+    RESET_FW_PG_FAULT       = 2, /* PG signal of a regulator went down */
+    RESET_FW_POWER_ERROR    = 3, /* regulators failed to start repeatedly */
+    RESET_FW_I2C            = 4, /* hard reset requested over I2C */
+    RESET_FW_HARD_FAULT     = 5, /* MCU firmware crashed */
+} reset_fw_cause_t;
+
+/* causes of MCU restarts counted in EEPROM */
+typedef enum reset_causes {
+    RESET_CAUSE_POWER_ON    = 0,
+    RESET_CAUSE_PIN         = 1,
+    RESET_CAUSE_OTHER       = 2, /* software reset without firmware cause,
+                                    low-power, option bytes */
+    RESET_CAUSE_MCU_WATCHDOG = 3, /* MCU firmware hang */
+    RESET_CAUSE_CPU_WATCHDOG = 4,
+    RESET_CAUSE_POWER_FAULT = 5, /* PG fault or power error */
+    RESET_CAUSE_I2C         = 6,
+    RESET_CAUSE_HARD_FAULT  = 7,
+    RESET_CAUSE_COUNT
+} reset_cause_t;
+
+/*******************************************************************************
+  * @function   reset_cause_capture
+  * @brief      Take and clear reset flags and firmware cause of the reset.
+  *             Called at the start of main().
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+void reset_cause_capture(void);
+
+/*******************************************************************************
+  * @function   reset_cause_set_fw
+  * @brief      Store the firmware cause of the reset which follows.
+  * @param      cause: firmware cause.
+  * @retval     None.
+  *****************************************************************************/
+void reset_cause_set_fw(reset_fw_cause_t cause);
+
+/*******************************************************************************
+  * @function   reset_cause_count
+  * @brief      Load counters of causes from EEPROM and count the last reset.
+  *             EEPROM must be initialized.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+void reset_cause_count(void);
+
+/*******************************************************************************
+  * @function   reset_cause_get_flags
+  * @brief      Reset flags of the last reset.
+  * @param      None.
+  * @retval     RESET_FLAG_x mask.
+  *****************************************************************************/
+uint8_t reset_cause_get_flags(void);
+
+/*******************************************************************************
+  * @function   reset_cause_get_fw
+  * @brief      Firmware cause of the last reset.
+  * @param      None.
+  * @retval     Firmware cause.
+  *****************************************************************************/
+reset_fw_cause_t reset_cause_get_fw(void);
+
+/*******************************************************************************
+  * @function   reset_cause_get
+  * @brief      Cause of the last reset, firmware cause takes precedence.
+  * @param      None.
+  * @retval     Cause.
+  *****************************************************************************/
+reset_cause_t reset_cause_get(void);
+
+/*******************************************************************************
+  * @function   reset_cause_get_counter
+  * @brief      Number of resets with the cause (saturated).
+  * @param      cause: cause.
+  * @retval     Counter.
+  *****************************************************************************/
+uint16_t reset_cause_get_counter(reset_cause_t cause);
+
+#endif /* RESET_CAUSE_H */
@@ -0,0 +1,175 @@
+/**
+ ******************************************************************************
+ * @file    scheduler.c
+ * @author  CZ.NIC, z.s.p.o.
+ * @date    18-October-2026
+ * @brief   Cooperative scheduler of periodic and event triggered tasks with
+ *          run time accounting. Tasks are run from the main loop, the MCU
+ *          sleeps between them.
+ ******************************************************************************
+ ******************************************************************************
+ **/
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f0xx.h"
+#include "scheduler.h"
+#include "app.h"
+#include "delay.h"
+
+#define LOAD_WINDOW                 1000 /* ms */
+
+static struct st_task *task_table;
+static uint8_t task_count;
+static uint32_t window_start;
+
+/*******************************************************************************
+  * @function   scheduler_init
+  * @brief      Register the task table. Tasks run in order of the table.
+  * @param      tasks: task table.
+  * @param      count: number of tasks.
+  * @retval     None.
+  *****************************************************************************/
+void scheduler_init(struct st_task *tasks, uint8_t count)
+{
+    uint8_t idx;
+
+    task_table = tasks;
+    task_count = count;
+    window_start = delay_get_uptime();
+
+    for (idx = 0; idx < count; idx++)
+        tasks[idx].state.next_run = window_start;
+}
+
+/*******************************************************************************
+  * @function   scheduler_update_load
+  * @brief      Evaluate run time of all tasks at the end of each window.
+  * @param      now: current uptime.
+  * @retval     None.
+  *****************************************************************************/
+static void scheduler_update_load(uint32_t now)
+{
+    struct st_task *task;
+    uint32_t window = now - window_start;
+    uint8_t idx;
+
+    if (window < LOAD_WINDOW)
+        return;
+
+    for (idx = 0; idx < task_count; idx++)
+    {
+        task = &task_table[idx];
+        /* run time in 0.1 % of the window (us / ms) */
+        task->state.load = task->state.run_time / window;
+        task->state.run_time = 0;
+    }
+
+    window_start = now;
+}
+
+/*******************************************************************************
+  * @function   scheduler_run_task
+  * @brief      Run one task and measure its run time.
+  * @param      task: task to be run.
+  * @retval     None.
+  *****************************************************************************/
+static void scheduler_run_task(struct st_task *task)
+{
+    uint32_t start, time;
+
+    task->state.pending = 0;
+
+    start = delay_get_time_us();
+    task->handler();
+    time = delay_get_time_us() - start;
+
+    task->state.runs++;
+    task->state.run_time += time;
+
+    if (time > task->state.max_time)
+        task->state.max_time = (time < 0xFFFF) ? time : 0xFFFF;
+}
+
+/*******************************************************************************
+  * @function   scheduler_run
+  * @brief      Run enabled tasks which are due, triggered or waiting for one
+  *             of the posted events.
+  * @param      events: app events posted since the last call.
+  * @retval     None.
+  *****************************************************************************/
+void scheduler_run(uint8_t events)
+{
+    struct st_task *task;
+    uint32_t now = delay_get_uptime();
+    uint8_t idx, due;
+
+    for (idx = 0; idx < task_count; idx++)
+    {
+        task = &task_table[idx];
+
+        if (!task->state.enabled)
+            continue;
+
+        due = task->state.pending || (task->events & events);
+
+        if (task->period && ((int32_t)(now - task->state.next_run) >= 0))
+        {
+            due = 1;
+            task->state.next_run += task->period;
+
+            /* do not try to catch up missed periods */
+            if ((int32_t)(now - task->state.next_run) >= 0)
+                task->state.next_run = now + task->period;
+        }
+
+        if (due)
+            scheduler_run_task(task);
+    }
+
+    scheduler_update_load(now);
+}
+
+/*******************************************************************************
+  * @function   scheduler_trigger
+  * @brief      Request a run of the task in the next scheduler pass.
+  * @param      task: task index.
+  * @retval     None.
+  *****************************************************************************/
+void scheduler_trigger(uint8_t task)
+{
+    if (task >= task_count)
+        return;
+
+    task_table[task].state.pending = 1;
+    app_post_event(APP_EVENT_TASK); /* do not sleep before the next pass */
+}
+
+/*******************************************************************************
+  * @function   scheduler_enable
+  * @brief      Enable or disable the task. Enabled periodic task runs at once.
+  * @param      task: task index.
+  * @param      state: ENABLE or DISABLE.
+  * @retval     None.
+  *****************************************************************************/
+void scheduler_enable(uint8_t task, FunctionalState state)
+{
+    if (task >= task_count)
+        return;
+
+    task_table[task].state.enabled = (state == ENABLE);
+    task_table[task].state.pending = 0;
+    task_table[task].state.next_run = delay_get_uptime();
+}
+
+/*******************************************************************************
+  * @function   scheduler_get_task
+  * @brief      Access to the task statistics.
+  * @param      task: task index.
+  * @retval     Task or 0 if the index is out of range.
+  *****************************************************************************/
+const struct st_task *scheduler_get_task(uint8_t task)
+{
+    if (task >= task_count)
+        return 0;
+
+    return &task_table[task];
+}
@@ -0,0 +1,76 @@
+/**
+ ******************************************************************************
+ * @file    scheduler.h
+ * @author  CZ.NIC, z.s.p.o.
+ * @date    18-October-2026
+ * @brief   Header file for scheduler.c
+ ******************************************************************************
+ ******************************************************************************
+ **/
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+typedef void (*task_handler_t)(void);
+
+/* run state and statistics of a task, zero at start */
+struct st_task_state {
+    uint8_t enabled     :1;
+    uint8_t pending     :1;     /* triggered, runs in the next pass */
+    uint32_t next_run;          /* uptime of the next periodic run [ms] */
+    uint32_t runs;              /* number of runs since start */
+    uint32_t run_time;          /* run time in the current window [us] */
+    uint16_t load;              /* run time in the last window [0.1 %] */
+    uint16_t max_time;          /* the longest run since start [us] */
+};
+
+struct st_task {
+    task_handler_t handler;
+    uint16_t period;            /* [ms], 0 - task runs on events only */
+    uint8_t events;             /* app_event_t which trigger the task */
+    struct st_task_state state;
+};
+
+/*******************************************************************************
+  * @function   scheduler_init
+  * @brief      Register the task table. Tasks run in order of the table.
+  * @param      tasks: task table.
+  * @param      count: number of tasks.
+  * @retval     None.
+  *****************************************************************************/
+void scheduler_init(struct st_task *tasks, uint8_t count);
+
+/*******************************************************************************
+  * @function   scheduler_run
+  * @brief      Run enabled tasks which are due, triggered or waiting for one
+  *             of the posted events.
+  * @param      events: app events posted since the last call.
+  * @retval     None.
+  *****************************************************************************/
+void scheduler_run(uint8_t events);
+
+/*******************************************************************************
+  * @function   scheduler_trigger
+  * @brief      Request a run of the task in the next scheduler pass.
+  * @param      task: task index.
+  * @retval     None.
+  *****************************************************************************/
+void scheduler_trigger(uint8_t task);
+
+/*******************************************************************************
+  * @function   scheduler_enable
+  * @brief      Enable or disable the task. Enabled periodic task runs at once.
+  * @param      task: task index.
+  * @param      state: ENABLE or DISABLE.
+  * @retval     None.
+  *****************************************************************************/
+void scheduler_enable(uint8_t task, FunctionalState state);
+
+/*******************************************************************************
+  * @function   scheduler_get_task
+  * @brief      Access to the task statistics.
+  * @param      task: task index.
+  * @retval     Task or 0 if the index is out of range.
+  *****************************************************************************/
+const struct st_task *scheduler_get_task(uint8_t task);
+
+#endif /* SCHEDULER_H */
@@ -18,6 +18,15 @@
 #include "debounce.h"
 #include "eeprom.h"
 #include "msata_pci.h"
+#include "app.h"
+#include "telemetry.h"
+#include "gesture.h"
+#include "scheduler.h"
+#include "profile.h"
+#include "ram_monitor.h"
+#include "crash.h"
+#include "reset_cause.h"
+#include "trace.h"
 
 static const uint8_t version[] = VERSION;
 
@@ -40,6 +49,10 @@ static const uint8_t version[] = VERSION;
 #define CMD_INDEX                       0
 #define NUMBER_OF_BYTES_VERSION         MAX_TX_BUFFER_SIZE
 #define BOOTLOADER_VERSION_ADDR         0x080000C0
+#define TASK_PAGE_ENTRIES               (MAX_TX_BUFFER_SIZE / 4) /* 4B per task */
+#define TASK_PAGE_COUNT                 8 /* upper limit, page must start with a task */
+#define IRQ_PAGE_ENTRIES                (MAX_TX_BUFFER_SIZE / 4) /* 4B per interrupt */
+#define IRQ_PAGE_COUNT                  ((PROFILE_COUNT + IRQ_PAGE_ENTRIES - 1) / IRQ_PAGE_ENTRIES)
 
 enum i2c_commands {
     CMD_GET_STATUS_WORD                 = 0x01, /* slave sends status word back */
@@ -59,6 +72,26 @@ enum i2c_commands {
 
     CMD_LED_COLOR_CORRECTION            = 0x10,
     CMD_LED_SET_PATTERN                 = 0x11,
+    CMD_GET_USB_OVC_STATS               = 0x12, /* 2x 8B recovery state of USB ports */
+    CMD_GET_CPU_LOAD                    = 0x13, /* 2B busy time in 0.1 % */
+    CMD_GET_TELEMETRY                   = 0x14, /* 12B temperature and VDDA */
+    CMD_SET_WATCHDOG_TIMEOUT            = 0x15, /* 2B timeout in seconds -> permanently */
+    CMD_WATCHDOG_KICK                   = 0x16, /* restart watchdog timeout */
+    CMD_GET_WATCHDOG_INFO               = 0x17, /* 6B timeout, remaining time, resets */
+    CMD_GET_BUTTON_EVENT                = 0x18, /* 8B the oldest button gesture */
+    CMD_SET_BUTTON_TIMING               = 0x19, /* 4B long press and click gap in ms */
+    CMD_GET_PG_GLITCHES                 = 0x1A, /* 20B glitch counters of PG lines */
+    CMD_GET_TASK_STATS                  = 0x1B, /* 20B load and max. run time of tasks (selected page) */
+    CMD_GET_IRQ_STATS                   = 0x1C, /* 20B load and max. run time of interrupts (selected page) */
+    CMD_GET_RAM_USAGE                   = 0x1D, /* 20B stack and static RAM usage */
+    CMD_GET_CRASH_INFO                  = 0x1E, /* 20B record of the last HardFault */
+    CMD_GET_RESET_CAUSE                 = 0x1F, /* 20B cause of MCU reset and counters */
+    CMD_GET_TRACE                       = 0x20, /* 20B page of event trace, next page is selected */
+    CMD_SET_TRACE_PAGE                  = 0x21, /* 1B select page of event trace */
+    CMD_GET_EEPROM_WEAR                 = 0x22, /* 20B erase counters of EEPROM emulation pages */
+    CMD_LED_PROFILE                     = 0x23, /* 1B 1 - save LED configuration, 0 - forget it */
+    CMD_SET_TASK_PAGE                   = 0x24, /* 1B select page of task statistics */
+    CMD_SET_IRQ_PAGE                    = 0x25, /* 1B select page of interrupt statistics */
 };
 
 enum i2c_control_byte_mask {
@@ -76,6 +109,10 @@ enum expected_bytes_in_cmd {
     ONE_BYTE_EXPECTED                   = 1,
     TWO_BYTES_EXPECTED                  = 2,
     FOUR_BYTES_EXPECTED                 = 4,
+    SIX_BYTES_EXPECTED                  = 6,
+    EIGHT_BYTES_EXPECTED                = 8,
+    TWELVE_BYTES_EXPECTED               = 12,
+    SIXTEEN_BYTES_EXPECTED              = 16,
     TWENTY_BYTES_EXPECTED               = 20
 };
 
@@ -93,6 +130,9 @@ enum boot_requests {
 };
 
 struct st_i2c_status i2c_status;
+static uint8_t trace_page; /* next page read by CMD_GET_TRACE */
+static uint8_t task_page; /* page read by CMD_GET_TASK_STATS, then back to 0 */
+static uint8_t irq_page; /* page read by CMD_GET_IRQ_STATS, then back to 0 */
 
 /*******************************************************************************
   * @brief  This function reads data from flash, byte after byte
@@ -253,6 +293,8 @@ static void slave_i2c_check_control_byte(uint8_t control_byte, uint8_t bit_mask)
 
     if (bit_mask & USB30_PWRON_MASK)
     {
+        power_control_usb_recovery_reset(USB3_PORT0);
+
         if (control_byte & USB30_PWRON_MASK)
         {
             power_control_usb(USB3_PORT0, USB_ON);
@@ -267,6 +309,8 @@ static void slave_i2c_check_control_byte(uint8_t control_byte, uint8_t bit_mask)
 
     if (bit_mask & USB31_PWRON_MASK)
     {
+        power_control_usb_recovery_reset(USB3_PORT1);
+
         if (control_byte & USB31_PWRON_MASK)
         {
             power_control_usb(USB3_PORT1, USB_ON);
@@ -311,7 +355,9 @@ static void slave_i2c_check_control_byte(uint8_t control_byte, uint8_t bit_mask)
     {
         if (control_byte & BOOTLOADER_MASK)
         {
-            ee_var = EE_WriteVariable(RESET_VIRT_ADDR, BOOTLOADER_REQ);
+            /* flash must not be written in interrupt (it could break
+               a write in progress), it is flushed before the jump */
+            ee_var = EE_WriteVariableDeferred(RESET_VIRT_ADDR, BOOTLOADER_REQ);
 
             switch(ee_var)
             {
@@ -327,6 +373,30 @@ static void slave_i2c_check_control_byte(uint8_t control_byte, uint8_t bit_mask)
     }
 }
 
+/*******************************************************************************
+  * @function   slave_i2c_trace_command
+  * @brief      Record the finished command in the event trace. Reading of the
+  *             trace and polling of the status word are left out, they would
+  *             overwrite the events of interest.
+  * @param      cmd: received command.
+  * @param      len: number of received data bytes.
+  * @retval     None.
+  *****************************************************************************/
+static void slave_i2c_trace_command(uint8_t cmd, uint8_t len)
+{
+    switch (cmd)
+    {
+        case CMD_GET_STATUS_WORD:
+        case CMD_GET_TRACE:
+        case CMD_SET_TRACE_PAGE:
+            break;
+
+        default:
+            trace_event(TRACE_I2C_CMD, cmd | (len << 8));
+            break;
+    }
+}
+
 /*******************************************************************************
   * @function   slave_i2c_handler
   * @brief      Interrupt handler for I2C communication.
@@ -402,6 +472,7 @@ void slave_i2c_handler(void)
                 DBG("NACK-MAX\r\n");
                 I2C_AcknowledgeConfig(I2C_PERIPH_NAME, DISABLE);
                 I2C_NumberOfBytesConfig(I2C_PERIPH_NAME, ONE_BYTE_EXPECTED);
+                __enable_irq();
                 return;
             }
 
@@ -434,11 +505,8 @@ void slave_i2c_handler(void)
                         else
                             led_set_user_mode_all(mode);
 
-                        DBG("set LED mode - LED index : ");
-                        DBG((const char*)(i2c_state->rx_buf[1] & 0x0F));
-                        DBG("\r\nLED mode: ");
-                        DBG((const char*)((i2c_state->rx_buf[1] & 0x0F) >> 4));
-                        DBG("\r\n");
+                        DBG("set LED mode - LED index : %d\r\nLED mode: %d\r\n",
+                            led, mode);
                     }
                     DBG("ACK\r\n");
                     I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
@@ -460,11 +528,8 @@ void slave_i2c_handler(void)
                         else
                             led_set_state_user_all(state);
 
-                        DBG("set LED state - LED index : ");
-                        DBG((const char*)(i2c_state->rx_buf[1] & 0x0F));
-                        DBG("\r\nLED state: ");
-                        DBG((const char*)((i2c_state->rx_buf[1] & 0x0F) >> 4));
-                        DBG("\r\n");
+                        DBG("set LED state - LED index : %d\r\nLED state: %d\r\n",
+                            led, state);
                     }
                     DBG("ACK\r\n");
                     I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
@@ -489,11 +554,8 @@ void slave_i2c_handler(void)
                         else
                             led_set_colour_all(colour);
 
-                        DBG("set LED colour - LED index : ");
-                        DBG((const char*)&led);
-                        DBG("\r\nRED: ");
-                        DBG((const char*)(i2c_state->rx_buf + 2));
-                        DBG("\r\n");
+                        DBG("set LED colour - LED index : %u\r\ncolour: %06x\r\n",
+                            led, colour);
                     }
                     DBG("ACK\r\n");
                     I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
@@ -554,9 +616,7 @@ void slave_i2c_handler(void)
                     {
                         led_pwm_set_brightness(i2c_state->rx_buf[1]);
 
-                        DBG("brightness: ");
-                        DBG((const char*)(i2c_state->rx_buf + 1));
-                        DBG("\r\n");
+                        DBG("brightness: %u\r\n", i2c_state->rx_buf[1]);
                     }
                     DBG("ACK\r\n");
                     I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
@@ -570,9 +630,7 @@ void slave_i2c_handler(void)
                     {
                         power_control_set_voltage(i2c_state->rx_buf[1]);
 
-                        DBG("user voltage: ");
-                        DBG((const char*)(i2c_state->rx_buf + 1));
-                        DBG("\r\n");
+                        DBG("user voltage: %u\r\n", i2c_state->rx_buf[1]);
                     }
                     DBG("ACK\r\n");
                     I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
@@ -586,9 +644,7 @@ void slave_i2c_handler(void)
                     {
                         wdg->watchdog_state = i2c_state->rx_buf[1];
 
-                        DBG("WDT STATE: ");
-                        DBG((const char*)(i2c_state->rx_buf + 1));
-                        DBG("\r\n");
+                        DBG("WDT STATE: %u\r\n", i2c_state->rx_buf[1]);
                     }
                     DBG("ACK\r\n");
                     I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
@@ -602,7 +658,7 @@ void slave_i2c_handler(void)
                     {
                         wdg->watchdog_sts = i2c_state->rx_buf[1];
 
-                        ee_var = EE_WriteVariable(WDG_VIRT_ADDR, wdg->watchdog_sts);
+                        ee_var = EE_WriteVariableDeferred(WDG_VIRT_ADDR, wdg->watchdog_sts);
 
                         switch(ee_var)
                         {
@@ -613,9 +669,7 @@ void slave_i2c_handler(void)
                                 break;
                         }
 
-                        DBG("WDT: ");
-                        DBG((const char*)(i2c_state->rx_buf + 1));
-                        DBG("\r\n");
+                        DBG("WDT: %u\r\n", i2c_state->rx_buf[1]);
                     }
                     DBG("ACK\r\n");
                     I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
@@ -687,6 +741,434 @@ void slave_i2c_handler(void)
                     I2C_NumberOfBytesConfig(I2C_PERIPH_NAME, TWENTY_BYTES_EXPECTED);
                 } break;
 
+                case CMD_GET_USB_OVC_STATS:
+                {
+                    struct st_usb_ovc *ovc;
+                    uint8_t port, *buf = i2c_state->tx_buf;
+
+                    for (port = 0; port < USB_PORT_COUNT; port++)
+                    {
+                        ovc = &usb_ovc[port];
+                        buf[0] = ovc->state;
+                        buf[1] = ovc->retries;
+                        buf[2] = ovc->fault_count & 0xFF;
+                        buf[3] = ovc->fault_count >> 8;
+                        buf[4] = ovc->last_fault & 0xFF;
+                        buf[5] = (ovc->last_fault >> 8) & 0xFF;
+                        buf[6] = (ovc->last_fault >> 16) & 0xFF;
+                        buf[7] = ovc->last_fault >> 24;
+                        buf += 8;
+                    }
+                    DBG("USB OVC\r\n");
+
+                    I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
+                    I2C_NumberOfBytesConfig(I2C_PERIPH_NAME, SIXTEEN_BYTES_EXPECTED);
+                } break;
+
+                case CMD_GET_CPU_LOAD:
+                {
+                    uint16_t load = app_get_cpu_load();
+
+                    i2c_state->tx_buf[0] = load & 0xFF;
+                    i2c_state->tx_buf[1] = load >> 8;
+                    DBG("CPU\r\n");
+
+                    I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
+                    I2C_NumberOfBytesConfig(I2C_PERIPH_NAME, TWO_BYTES_EXPECTED);
+                } break;
+
+                case CMD_GET_TELEMETRY:
+                {
+                    struct st_telemetry *tlm;
+                    uint8_t ch, *buf = i2c_state->tx_buf;
+
+                    for (ch = 0; ch < TELEMETRY_CHANNELS; ch++)
+                    {
+                        tlm = &telemetry[ch];
+                        buf[0] = tlm->value & 0xFF;
+                        buf[1] = (tlm->value >> 8) & 0xFF;
+                        buf[2] = tlm->min & 0xFF;
+                        buf[3] = (tlm->min >> 8) & 0xFF;
+                        buf[4] = tlm->max & 0xFF;
+                        buf[5] = (tlm->max >> 8) & 0xFF;
+                        buf += 6;
+                    }
+                    DBG("TLM\r\n");
+
+                    I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
+                    I2C_NumberOfBytesConfig(I2C_PERIPH_NAME, TWELVE_BYTES_EXPECTED);
+                } break;
+
+                case CMD_SET_WATCHDOG_TIMEOUT:
+                {
+                    if((i2c_state->rx_data_ctr -1) == TWO_BYTES_EXPECTED)
+                    {
+                        uint16_t timeout;
+
+                        timeout = i2c_state->rx_buf[1] | (i2c_state->rx_buf[2] << 8);
+
+                        if (timeout)
+                        {
+                            wdg->watchdog_timeout = timeout;
+                            delay_watchdog_kick();
+
+                            ee_var = EE_WriteVariableDeferred(WDG_TIMEOUT_VIRT_ADDR, timeout);
+
+                            switch(ee_var)
+                            {
+                                case VAR_FLASH_COMPLETE: DBG("WDT TO: OK\r\n"); break;
+                                case VAR_PAGE_FULL: DBG("WDT TO: Pg full\r\n"); break;
+                                case VAR_NO_VALID_PAGE: DBG("WDT TO: No Pg\r\n"); break;
+                                default:
+                                    break;
+                            }
+                        }
+                    }
+                    DBG("ACK\r\n");
+                    I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
+                    /* release SCL line */
+                    I2C_NumberOfBytesConfig(I2C_PERIPH_NAME, ONE_BYTE_EXPECTED);
+                } break;
+
+                case CMD_WATCHDOG_KICK:
+                {
+                    delay_watchdog_kick();
+                    DBG("WDT KICK\r\n");
+
+                    I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
+                    I2C_NumberOfBytesConfig(I2C_PERIPH_NAME, ONE_BYTE_EXPECTED);
+                } break;
+
+                case CMD_GET_WATCHDOG_INFO:
+                {
+                    uint16_t remaining = delay_watchdog_remaining();
+                    uint32_t resets = reset_cause_get_counter(RESET_CAUSE_MCU_WATCHDOG) +
+                                      reset_cause_get_counter(RESET_CAUSE_CPU_WATCHDOG);
+
+                    if (resets > 0xFFFF)
+                        resets = 0xFFFF;
+
+                    i2c_state->tx_buf[0] = wdg->watchdog_timeout & 0xFF;
+                    i2c_state->tx_buf[1] = wdg->watchdog_timeout >> 8;
+                    i2c_state->tx_buf[2] = remaining & 0xFF;
+                    i2c_state->tx_buf[3] = remaining >> 8;
+                    i2c_state->tx_buf[4] = resets & 0xFF;
+                    i2c_state->tx_buf[5] = resets >> 8;
+                    DBG("WDT INFO\r\n");
+
+                    I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
+                    I2C_NumberOfBytesConfig(I2C_PERIPH_NAME, SIX_BYTES_EXPECTED);
+                } break;
+
+                case CMD_GET_BUTTON_EVENT:
+                {
+                    struct st_gesture_event event;
+                    uint8_t pending;
+
+                    pending = gesture_get_event(&event);
+
+                    i2c_state->tx_buf[0] = event.type;
+                    i2c_state->tx_buf[1] = pending;
+                    i2c_state->tx_buf[2] = event.duration & 0xFF;
+                    i2c_state->tx_buf[3] = event.duration >> 8;
+                    i2c_state->tx_buf[4] = event.timestamp & 0xFF;
+                    i2c_state->tx_buf[5] = (event.timestamp >> 8) & 0xFF;
+                    i2c_state->tx_buf[6] = (event.timestamp >> 16) & 0xFF;
+                    i2c_state->tx_buf[7] = event.timestamp >> 24;
+
+                    if (!pending)
+                        i2c_state->status_word &= ~BUTTON_EVENT_STSBIT;
+
+                    DBG("BTN EVT\r\n");
+
+                    I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
+                    I2C_NumberOfBytesConfig(I2C_PERIPH_NAME, EIGHT_BYTES_EXPECTED);
+                } break;
+
+                case CMD_SET_BUTTON_TIMING:
+                {
+                    if((i2c_state->rx_data_ctr -1) == FOUR_BYTES_EXPECTED)
+                    {
+                        gesture_set_timing(i2c_state->rx_buf[1] | (i2c_state->rx_buf[2] << 8),
+                                           i2c_state->rx_buf[3] | (i2c_state->rx_buf[4] << 8));
+                        DBG("BTN TIMING\r\n");
+                    }
+                    DBG("ACK\r\n");
+                    I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
+                    /* release SCL line */
+                    I2C_NumberOfBytesConfig(I2C_PERIPH_NAME, ONE_BYTE_EXPECTED);
+                } break;
+
+                case CMD_GET_PG_GLITCHES:
+                {
+                    struct st_pg_glitches *glitch = &pg_glitches;
+                    uint8_t idx, *buf = i2c_state->tx_buf;
+
+                    for (idx = 0; idx < PG_LINE_COUNT; idx++)
+                    {
+                        buf[0] = glitch->count[idx] & 0xFF;
+                        buf[1] = glitch->count[idx] >> 8;
+                        buf += 2;
+                    }
+                    buf[0] = glitch->last_glitch & 0xFF;
+                    buf[1] = (glitch->last_glitch >> 8) & 0xFF;
+                    buf[2] = (glitch->last_glitch >> 16) & 0xFF;
+                    buf[3] = glitch->last_glitch >> 24;
+                    DBG("PG GLITCH\r\n");
+
+                    I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
+                    I2C_NumberOfBytesConfig(I2C_PERIPH_NAME, TWENTY_BYTES_EXPECTED);
+                } break;
+
+                case CMD_GET_TASK_STATS:
+                {
+                    const struct st_task *task;
+                    uint8_t idx, *buf = i2c_state->tx_buf;
+
+                    for (idx = 0; idx < TASK_PAGE_ENTRIES; idx++)
+                    {
+                        task = scheduler_get_task(task_page * TASK_PAGE_ENTRIES + idx);
+
+                        if (task)
+                        {
+                            buf[0] = task->state.load & 0xFF;
+                            buf[1] = task->state.load >> 8;
+                            buf[2] = task->state.max_time & 0xFF;
+                            buf[3] = task->state.max_time >> 8;
+                        }
+                        else
+                        {
+                            buf[0] = buf[1] = buf[2] = buf[3] = 0xFF;
+                        }
+                        buf += 4;
+                    }
+                    /* readers which don't know the pages get the first one */
+                    task_page = 0;
+                    DBG("TASKS\r\n");
+
+                    I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
+                    I2C_NumberOfBytesConfig(I2C_PERIPH_NAME, TWENTY_BYTES_EXPECTED);
+                } break;
+
+                case CMD_GET_IRQ_STATS:
+                {
+                    uint16_t load, max_time;
+                    uint8_t idx, id, *buf = i2c_state->tx_buf;
+
+                    for (idx = 0; idx < IRQ_PAGE_ENTRIES; idx++)
+                    {
+                        id = irq_page * IRQ_PAGE_ENTRIES + idx;
+
+                        if (id < PROFILE_COUNT)
+                        {
+                            load = profile_get_load(id);
+                            max_time = profile_get_max_time(id);
+
+                            buf[0] = load & 0xFF;
+                            buf[1] = load >> 8;
+                            buf[2] = max_time & 0xFF;
+                            buf[3] = max_time >> 8;
+                        }
+                        else
+                        {
+                            buf[0] = buf[1] = buf[2] = buf[3] = 0xFF;
+                        }
+                        buf += 4;
+                    }
+                    /* readers which don't know the pages get the first one */
+                    irq_page = 0;
+                    DBG("IRQS\r\n");
+
+                    I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
+                    I2C_NumberOfBytesConfig(I2C_PERIPH_NAME, TWENTY_BYTES_EXPECTED);
+                } break;
+
+                case CMD_GET_RAM_USAGE:
+                {
+                    uint16_t size[3];
+                    uint8_t idx, *buf = i2c_state->tx_buf;
+
+                    size[0] = ram_monitor_stack_size();
+                    size[1] = ram_monitor_stack_free();
+                    size[2] = ram_monitor_static_size();
+
+                    for (idx = 0; idx < 3; idx++)
+                    {
+                        buf[0] = size[idx] & 0xFF;
+                        buf[1] = size[idx] >> 8;
+                        buf += 2;
+                    }
+
+                    for (idx = 0; idx < RAM_MODULE_COUNT; idx++)
+                    {
+                        size[0] = ram_monitor_module_size(idx);
+                        buf[0] = size[0] & 0xFF;
+                        buf[1] = size[0] >> 8;
+                        buf += 2;
+                    }
+                    DBG("RAM\r\n");
+
+                    I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
+                    I2C_NumberOfBytesConfig(I2C_PERIPH_NAME, TWENTY_BYTES_EXPECTED);
+                } break;
+
+                case CMD_GET_CRASH_INFO:
+                {
+                    const struct st_crash_info *crash = crash_get_info();
+                    uint32_t regs[4];
+                    uint8_t idx, *buf = i2c_state->tx_buf;
+
+                    if (crash)
+                    {
+                        regs[0] = crash->pc;
+                        regs[1] = crash->lr;
+                        regs[2] = crash->xpsr;
+                        regs[3] = crash->icsr;
+
+                        for (idx = 0; idx < 4; idx++)
+                        {
+                            buf[0] = regs[idx] & 0xFF;
+                            buf[1] = (regs[idx] >> 8) & 0xFF;
+                            buf[2] = (regs[idx] >> 16) & 0xFF;
+                            buf[3] = regs[idx] >> 24;
+                            buf += 4;
+                        }
+                        /* RAM is 8kB, lower half of SP is enough */
+                        buf[0] = crash->sp & 0xFF;
+                        buf[1] = (crash->sp >> 8) & 0xFF;
+                        buf[2] = crash->reason;
+                        buf[3] = crash->count;
+                    }
+                    else
+                    {
+                        for (idx = 0; idx < MAX_TX_BUFFER_SIZE; idx++)
+                            buf[idx] = 0;
+                    }
+                    DBG("CRASH\r\n");
+
+                    I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
+                    I2C_NumberOfBytesConfig(I2C_PERIPH_NAME, TWENTY_BYTES_EXPECTED);
+                } break;
+
+                case CMD_GET_RESET_CAUSE:
+                {
+                    uint16_t counter;
+                    uint8_t idx, *buf = i2c_state->tx_buf;
+
+                    buf[0] = reset_cause_get_flags();
+                    buf[1] = reset_cause_get_fw();
+                    buf[2] = reset_cause_get();
+                    buf[3] = 0;
+                    buf += 4;
+
+                    for (idx = 0; idx < RESET_CAUSE_COUNT; idx++)
+                    {
+                        counter = reset_cause_get_counter(idx);
+                        buf[0] = counter & 0xFF;
+                        buf[1] = counter >> 8;
+                        buf += 2;
+                    }
+                    DBG("RST CAUSE\r\n");
+
+                    I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
+                    I2C_NumberOfBytesConfig(I2C_PERIPH_NAME, TWENTY_BYTES_EXPECTED);
+                } break;
+
+                case CMD_GET_TRACE:
+                {
+                    trace_read_page(trace_page, i2c_state->tx_buf);
+
+                    if (++trace_page >= TRACE_PAGE_COUNT)
+                        trace_page = 0;
+
+                    DBG("TRACE\r\n");
+
+                    I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
+                    I2C_NumberOfBytesConfig(I2C_PERIPH_NAME, TWENTY_BYTES_EXPECTED);
+                } break;
+
+                case CMD_SET_TRACE_PAGE:
+                {
+                    if((i2c_state->rx_data_ctr -1) == ONE_BYTE_EXPECTED)
+                    {
+                        if (i2c_state->rx_buf[1] < TRACE_PAGE_COUNT)
+                            trace_page = i2c_state->rx_buf[1];
+
+                        DBG("TRACE PAGE\r\n");
+                    }
+                    DBG("ACK\r\n");
+                    I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
+                    /* release SCL line */
+                    I2C_NumberOfBytesConfig(I2C_PERIPH_NAME, ONE_BYTE_EXPECTED);
+                } break;
+
+                case CMD_SET_TASK_PAGE:
+                {
+                    if((i2c_state->rx_data_ctr -1) == ONE_BYTE_EXPECTED)
+                    {
+                        if ((i2c_state->rx_buf[1] < TASK_PAGE_COUNT) &&
+                            scheduler_get_task(i2c_state->rx_buf[1] * TASK_PAGE_ENTRIES))
+                            task_page = i2c_state->rx_buf[1];
+
+                        DBG("TASK PAGE\r\n");
+                    }
+                    DBG("ACK\r\n");
+                    I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
+                    /* release SCL line */
+                    I2C_NumberOfBytesConfig(I2C_PERIPH_NAME, ONE_BYTE_EXPECTED);
+                } break;
+
+                case CMD_SET_IRQ_PAGE:
+                {
+                    if((i2c_state->rx_data_ctr -1) == ONE_BYTE_EXPECTED)
+                    {
+                        if (i2c_state->rx_buf[1] < IRQ_PAGE_COUNT)
+                            irq_page = i2c_state->rx_buf[1];
+
+                        DBG("IRQ PAGE\r\n");
+                    }
+                    DBG("ACK\r\n");
+                    I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
+                    /* release SCL line */
+                    I2C_NumberOfBytesConfig(I2C_PERIPH_NAME, ONE_BYTE_EXPECTED);
+                } break;
+
+                case CMD_GET_EEPROM_WEAR:
+                {
+                    uint16_t counter;
+                    uint8_t idx, *buf = i2c_state->tx_buf;
+
+                    for (idx = 0; idx < MAX_TX_BUFFER_SIZE / 2; idx++)
+                    {
+                        counter = EE_GetEraseCount(idx);
+                        buf[0] = counter & 0xFF;
+                        buf[1] = counter >> 8;
+                        buf += 2;
+                    }
+                    DBG("EEPROM WEAR\r\n");
+
+                    I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
+                    I2C_NumberOfBytesConfig(I2C_PERIPH_NAME, TWENTY_BYTES_EXPECTED);
+                } break;
+
+                case CMD_LED_PROFILE:
+                {
+                    if((i2c_state->rx_data_ctr -1) == ONE_BYTE_EXPECTED)
+                    {
+                        /* flash is written in main loop */
+                        if (i2c_state->rx_buf[1])
+                            i2c_state->state = SLAVE_I2C_SAVE_LED_PROFILE;
+                        else
+                            i2c_state->state = SLAVE_I2C_CLEAR_LED_PROFILE;
+
+                        DBG("LED PROFILE\r\n");
+                    }
+                    DBG("ACK\r\n");
+                    I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
+                    /* release SCL line */
+                    I2C_NumberOfBytesConfig(I2C_PERIPH_NAME, ONE_BYTE_EXPECTED);
+                } break;
+
                 case 0x50:
                 {
                     extern uint32_t last_led_timer_start, last_led_timer_end;
@@ -741,11 +1223,8 @@ void slave_i2c_handler(void)
                             else
                                 led_set_user_mode_all(mode);
 
-                            DBG("set LED mode - LED index : ");
-                            DBG((const char*)(i2c_state->rx_buf[1] & 0x0F));
-                            DBG("\r\nLED mode: ");
-                            DBG((const char*)((i2c_state->rx_buf[1] & 0x0F) >> 4));
-                            DBG("\r\n");
+                            DBG("set LED mode - LED index : %d\r\nLED mode: %d\r\n",
+                                led, mode);
                         }
                         DBG("ACK\r\n");
                         I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
@@ -767,11 +1246,8 @@ void slave_i2c_handler(void)
                             else
                                 led_set_state_user_all(state);
 
-                            DBG("set LED state - LED index : ");
-                            DBG((const char*)(i2c_state->rx_buf[1] & 0x0F));
-                            DBG("\r\nLED state: ");
-                            DBG((const char*)((i2c_state->rx_buf[1] & 0x0F) >> 4));
-                            DBG("\r\n");
+                            DBG("set LED state - LED index : %d\r\nLED state: %d\r\n",
+                                led, state);
                         }
                         DBG("ACK\r\n");
                         I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
@@ -796,11 +1272,8 @@ void slave_i2c_handler(void)
                             else
                                 led_set_colour_all(colour);
 
-                            DBG("set LED colour - LED index : ");
-                            DBG((const char*)&led);
-                            DBG("\r\nRED: ");
-                            DBG((const char*)(i2c_state->rx_buf + 2));
-                            DBG("\r\n");
+                            DBG("set LED colour - LED index : %u\r\ncolour: %06x\r\n",
+                                led, colour);
                         }
                         DBG("ACK\r\n");
                         I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
@@ -814,9 +1287,7 @@ void slave_i2c_handler(void)
                         {
                             led_pwm_set_brightness(i2c_state->rx_buf[1]);
 
-                            DBG("brightness: ");
-                            DBG((const char*)(i2c_state->rx_buf + 1));
-                            DBG("\r\n");
+                            DBG("brightness: %u\r\n", i2c_state->rx_buf[1]);
                         }
                         DBG("ACK\r\n");
                         I2C_AcknowledgeConfig(I2C_PERIPH_NAME, ENABLE);
@@ -855,6 +1326,10 @@ void slave_i2c_handler(void)
     {
         I2C_ClearITPendingBit(I2C_PERIPH_NAME, I2C_IT_STOPF);
 
+        if (i2c_state->rx_data_ctr)
+            slave_i2c_trace_command(i2c_state->rx_buf[CMD_INDEX],
+                                    i2c_state->rx_data_ctr - 1);
+
         if (i2c_state->data_tx_complete) /* data have been sent to master */
         {
             i2c_state->data_tx_complete = 0;
@@ -19,7 +19,9 @@ typedef enum slave_i2c_states {
     SLAVE_I2C_LIGHT_RST,
     SLAVE_I2C_HARD_RST,
     SLAVE_I2C_PWR4V5_ENABLE,
-    SLAVE_I2C_GO_TO_BOOTLOADER
+    SLAVE_I2C_GO_TO_BOOTLOADER,
+    SLAVE_I2C_SAVE_LED_PROFILE,
+    SLAVE_I2C_CLEAR_LED_PROFILE
 }slave_i2c_states_t;
 
 struct st_i2c_status {
@@ -36,6 +38,7 @@ struct st_i2c_status {
 extern struct st_i2c_status i2c_status;
 
 enum status_word_bits {
+    BUTTON_EVENT_STSBIT    = 0x0001,
     CARD_DET_STSBIT        = 0x0010,
     MSATA_IND_STSBIT       = 0x0020,
     USB30_OVC_STSBIT       = 0x0040,
@@ -52,7 +55,7 @@ enum status_word_bits {
  * Bit meanings in status_word:
  *  Bit Nr. |   Meanings
  * -----------------
- *      0   |   dont care
+ *      0   |   BUTTON_EVENT    : 1 - button gesture event is queued (user mode), 0 - no event
  *      1   |   dont care
  *      2   |   dont care
  *      3   |   dont care
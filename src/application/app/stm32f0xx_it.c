@@ -31,6 +31,10 @@
 #include "slave_i2c_device.h"
 #include "power_control.h"
 #include "debug_serial.h"
+#include "sw_timer.h"
+#include "profile.h"
+#include "crash.h"
+#include "app.h"
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
@@ -53,16 +57,27 @@ void NMI_Handler(void)
 }
 
 /**
-  * @brief  This function handles Hard Fault exception.
+  * @brief  This function handles Hard Fault exception. The stack frame of
+  *         the fault (MSP or PSP according to EXC_RETURN) is passed to
+  *         crash_save(), which stores it and resets the MCU.
   * @param  None
   * @retval None
   */
-void HardFault_Handler(void)
+__attribute__((naked)) void HardFault_Handler(void)
 {
-  /* Go to infinite loop when Hard Fault exception occurs */
-  while (1)
-  {
-  }
+    __asm volatile (
+        "movs r0, #4        \n"
+        "mov  r1, lr        \n"
+        "tst  r0, r1        \n"
+        "beq  1f            \n"
+        "mrs  r0, psp       \n"
+        "b    2f            \n"
+        "1:                 \n"
+        "mrs  r0, msp       \n"
+        "2:                 \n"
+        "bl   crash_save    \n"
+        "b    .             \n"
+    );
 }
 
 /**
@@ -138,7 +153,15 @@ void PendSV_Handler(void)
   */
 void SysTick_Handler(void)
 {
+    PROFILE_ENTER(PROFILE_SYSTICK);
     delay_timing_decrement();
+
+    PROFILE_ENTER(PROFILE_SW_TIMERS);
+    sw_timer_tick(delay_get_uptime());
+    PROFILE_EXIT();
+
+    app_post_event(APP_EVENT_TICK);
+    PROFILE_EXIT();
 }
 
 /******************************************************************************/
@@ -146,78 +169,85 @@ void SysTick_Handler(void)
 /******************************************************************************/
 
 /**
-  * @brief  This function handles TIM16 global interrupt request.
+  * @brief  This function handles TIM3 global interrupt request.
   * @param  None
   * @retval None
   */
-void TIM16_IRQHandler(void)
+void TIM3_IRQHandler(void)
 {
-    if (TIM_GetITStatus(DEBOUNCE_TIMER, TIM_IT_Update) != RESET)
+    PROFILE_ENTER(PROFILE_LED);
+    if (TIM_GetITStatus(LED_TIMER, TIM_IT_Update) != RESET)
     {
-        debounce_input_timer_handler();
-        TIM_ClearITPendingBit(DEBOUNCE_TIMER, TIM_IT_Update);
+        led_timer_irq_handler();
+        TIM_ClearITPendingBit(LED_TIMER, TIM_IT_Update);
     }
+    PROFILE_EXIT();
 }
 
 /**
-  * @brief  This function handles TIM3 global interrupt request.
+  * @brief  This function handles I2C global interrupt request.
   * @param  None
   * @retval None
   */
-void TIM3_IRQHandler(void)
+void I2C2_IRQHandler(void)
 {
-    if (TIM_GetITStatus(LED_TIMER, TIM_IT_Update) != RESET)
-    {
-        led_timer_irq_handler();
-        TIM_ClearITPendingBit(LED_TIMER, TIM_IT_Update);
-    }
+    PROFILE_ENTER(PROFILE_I2C);
+    slave_i2c_handler();
+    app_post_event(APP_EVENT_I2C);
+    PROFILE_EXIT();
 }
 
-
 /**
-  * @brief  This function handles TIM17 global interrupt request.
+  * @brief  This function handles EXTI line 0 and 1 interrupt request.
   * @param  None
   * @retval None
   */
-void TIM17_IRQHandler(void)
+void EXTI0_1_IRQHandler(void)
 {
-    struct st_i2c_status *i2c_control = &i2c_status;
-
-    if (TIM_GetITStatus(USB_TIMEOUT_TIMER, TIM_IT_Update) != RESET)
-    {
-        power_control_usb(USB3_PORT0, USB_ON);
-        power_control_usb(USB3_PORT1, USB_ON);
-
-        i2c_control->status_word |= USB30_PWRON_STSBIT | USB31_PWRON_STSBIT;
-
-        power_control_usb_timeout_disable();
+    PROFILE_ENTER(PROFILE_EXTI);
+    debounce_exti_irq_handler();
+    app_post_event(APP_EVENT_INPUT);
+    PROFILE_EXIT();
+}
 
-        TIM_ClearITPendingBit(USB_TIMEOUT_TIMER, TIM_IT_Update);
-    }
+/**
+  * @brief  This function handles EXTI line 2 and 3 interrupt request.
+  * @param  None
+  * @retval None
+  */
+void EXTI2_3_IRQHandler(void)
+{
+    PROFILE_ENTER(PROFILE_EXTI);
+    debounce_exti_irq_handler();
+    app_post_event(APP_EVENT_INPUT);
+    PROFILE_EXIT();
 }
 
 /**
-  * @brief  This function handles I2C global interrupt request.
+  * @brief  This function handles EXTI line 4 to 15 interrupt request.
   * @param  None
   * @retval None
   */
-void I2C2_IRQHandler(void)
+void EXTI4_15_IRQHandler(void)
 {
-    slave_i2c_handler();
+    PROFILE_ENTER(PROFILE_EXTI);
+    debounce_exti_irq_handler();
+    app_post_event(APP_EVENT_INPUT);
+    PROFILE_EXIT();
 }
 
 /**
-  * @brief  This function handles TIM3 global interrupt request.
+  * @brief  This function handles DMA1 Channel 2 and 3 interrupt request.
   * @param  None
   * @retval None
   */
-void TIM6_IRQHandler(void)
+void DMA1_Channel2_3_IRQHandler(void)
 {
-    if (TIM_GetITStatus(LED_EFFECT_TIMER, TIM_IT_Update) != RESET)
-    {
-        led_knight_rider_effect_handler();
-        TIM_ClearITPendingBit(LED_EFFECT_TIMER, TIM_IT_Update);
-    }
+    PROFILE_ENTER(PROFILE_DMA);
+
+    debug_serial_dma_handler();
+
+    PROFILE_EXIT();
 }
 
 /**
@@ -0,0 +1,180 @@
+/**
+ ******************************************************************************
+ * @file    sw_timer.c
+ * @author  CZ.NIC, z.s.p.o.
+ * @date    18-October-2026
+ * @brief   One-shot and periodic software timers driven by System Timer.
+ *          Timers are kept in a wheel of lists indexed by the expiration
+ *          time, so only one short list is checked every ms.
+ ******************************************************************************
+ ******************************************************************************
+ **/
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f0xx.h"
+#include "sw_timer.h"
+#include "delay.h"
+
+#define WHEEL_SIZE                  16 /* power of 2 */
+#define WHEEL_SLOT(time)            ((time) & (WHEEL_SIZE - 1))
+
+static struct sw_timer *wheel[WHEEL_SIZE];
+
+/*******************************************************************************
+  * @function   sw_timer_link
+  * @brief      Insert the timer to the wheel slot of its expiration time.
+  *             Interrupts must be disabled.
+  * @param      timer: timer to be inserted.
+  * @retval     None.
+  *****************************************************************************/
+static void sw_timer_link(struct sw_timer *timer)
+{
+    struct sw_timer **slot = &wheel[WHEEL_SLOT(timer->expires)];
+
+    timer->next = *slot;
+    *slot = timer;
+    timer->active = 1;
+}
+
+/*******************************************************************************
+  * @function   sw_timer_unlink
+  * @brief      Remove the timer from the wheel. Interrupts must be disabled.
+  * @param      timer: timer to be removed.
+  * @retval     None.
+  *****************************************************************************/
+static void sw_timer_unlink(struct sw_timer *timer)
+{
+    struct sw_timer **link = &wheel[WHEEL_SLOT(timer->expires)];
+
+    while (*link)
+    {
+        if (*link == timer)
+        {
+            *link = timer->next;
+            break;
+        }
+
+        link = &(*link)->next;
+    }
+
+    timer->next = 0;
+    timer->active = 0;
+}
+
+/*******************************************************************************
+  * @function   sw_timer_init
+  * @brief      Initialize the timer, a running timer is stopped first.
+  * @param      timer: timer to be initialized.
+  * @param      callback: function called when the timer expires.
+  * @retval     None.
+  *****************************************************************************/
+void sw_timer_init(struct sw_timer *timer, sw_timer_callback_t callback)
+{
+    sw_timer_stop(timer);
+
+    timer->callback = callback;
+    timer->period = 0;
+}
+
+/*******************************************************************************
+  * @function   sw_timer_start
+  * @brief      (Re)start the timer.
+  * @param      timer: timer to be started.
+  * @param      delay: time to the first expiration [ms], at least 1 ms.
+  * @param      period: period of next expirations [ms], 0 - one-shot timer.
+  * @retval     None.
+  *****************************************************************************/
+void sw_timer_start(struct sw_timer *timer, uint32_t delay, uint32_t period)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    if (delay == 0)
+        delay = 1;
+
+    __disable_irq();
+
+    if (timer->active)
+        sw_timer_unlink(timer);
+
+    timer->expires = delay_get_uptime() + delay;
+    timer->period = period;
+    sw_timer_link(timer);
+
+    __set_PRIMASK(primask);
+}
+
+/*******************************************************************************
+  * @function   sw_timer_stop
+  * @brief      Stop the timer, it is safe to stop a stopped timer.
+  * @param      timer: timer to be stopped.
+  * @retval     None.
+  *****************************************************************************/
+void sw_timer_stop(struct sw_timer *timer)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+
+    if (timer->active)
+        sw_timer_unlink(timer);
+
+    __set_PRIMASK(primask);
+}
+
+/*******************************************************************************
+  * @function   sw_timer_is_active
+  * @brief      Check whether the timer runs.
+  * @param      timer: timer to be checked.
+  * @retval     1 - timer runs, 0 - timer is stopped.
+  *****************************************************************************/
+uint8_t sw_timer_is_active(const struct sw_timer *timer)
+{
+    return timer->active;
+}
+
+/*******************************************************************************
+  * @function   sw_timer_tick
+  * @brief      Expire due timers, called every ms from SysTick interrupt.
+  *             Callbacks may start or stop any timer, so the slot is searched
+  *             again after each of them.
+  * @param      now: current uptime [ms].
+  * @retval     None.
+  *****************************************************************************/
+void sw_timer_tick(uint32_t now)
+{
+    struct sw_timer *timer;
+    uint32_t primask = __get_PRIMASK();
+
+    while (1)
+    {
+        __disable_irq();
+
+        /* timers with delay longer than the wheel wait for next rounds */
+        for (timer = wheel[WHEEL_SLOT(now)]; timer; timer = timer->next)
+        {
+            if ((int32_t)(now - timer->expires) >= 0)
+                break;
+        }
+
+        if (timer == 0)
+            break;
+
+        sw_timer_unlink(timer);
+
+        if (timer->period)
+        {
+            timer->expires += timer->period;
+
+            /* do not try to catch up missed periods */
+            if ((int32_t)(now - timer->expires) >= 0)
+                timer->expires = now + timer->period;
+
+            sw_timer_link(timer);
+        }
+
+        __set_PRIMASK(primask);
+
+        timer->callback();
+    }
+
+    __set_PRIMASK(primask);
+}
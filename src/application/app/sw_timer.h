@@ -0,0 +1,66 @@
+/**
+ ******************************************************************************
+ * @file    sw_timer.h
+ * @author  CZ.NIC, z.s.p.o.
+ * @date    18-October-2026
+ * @brief   Header file for sw_timer.c
+ ******************************************************************************
+ ******************************************************************************
+ **/
+#ifndef SW_TIMER_H
+#define SW_TIMER_H
+
+typedef void (*sw_timer_callback_t)(void);
+
+struct sw_timer {
+    struct sw_timer *next;          /* next timer in the same wheel slot */
+    sw_timer_callback_t callback;   /* called from SysTick interrupt */
+    uint32_t expires;               /* uptime of the next expiration [ms] */
+    uint32_t period;                /* [ms], 0 - one-shot timer */
+    uint8_t active;
+};
+
+/*******************************************************************************
+  * @function   sw_timer_init
+  * @brief      Initialize the timer, a running timer is stopped first.
+  * @param      timer: timer to be initialized.
+  * @param      callback: function called when the timer expires.
+  * @retval     None.
+  *****************************************************************************/
+void sw_timer_init(struct sw_timer *timer, sw_timer_callback_t callback);
+
+/*******************************************************************************
+  * @function   sw_timer_start
+  * @brief      (Re)start the timer.
+  * @param      timer: timer to be started.
+  * @param      delay: time to the first expiration [ms], at least 1 ms.
+  * @param      period: period of next expirations [ms], 0 - one-shot timer.
+  * @retval     None.
+  *****************************************************************************/
+void sw_timer_start(struct sw_timer *timer, uint32_t delay, uint32_t period);
+
+/*******************************************************************************
+  * @function   sw_timer_stop
+  * @brief      Stop the timer, it is safe to stop a stopped timer.
+  * @param      timer: timer to be stopped.
+  * @retval     None.
+  *****************************************************************************/
+void sw_timer_stop(struct sw_timer *timer);
+
+/*******************************************************************************
+  * @function   sw_timer_is_active
+  * @brief      Check whether the timer runs.
+  * @param      timer: timer to be checked.
+  * @retval     1 - timer runs, 0 - timer is stopped.
+  *****************************************************************************/
+uint8_t sw_timer_is_active(const struct sw_timer *timer);
+
+/*******************************************************************************
+  * @function   sw_timer_tick
+  * @brief      Expire due timers, called every ms from SysTick interrupt.
+  * @param      now: current uptime [ms].
+  * @retval     None.
+  *****************************************************************************/
+void sw_timer_tick(uint32_t now);
+
+#endif /* SW_TIMER_H */
@@ -0,0 +1,205 @@
+/**
+ ******************************************************************************
+ * @file    telemetry.c
+ * @author  CZ.NIC, z.s.p.o.
+ * @date    18-October-2026
+ * @brief   ADC telemetry - internal temperature sensor and VREFINT are
+ *          converted continuously and stored by DMA to a circular buffer,
+ *          the main loop only filters the results.
+ ******************************************************************************
+ ******************************************************************************
+ **/
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f0xx_conf.h"
+#include "telemetry.h"
+
+/* Private define ------------------------------------------------------------*/
+#define TELEMETRY_ADC               ADC1
+#define TELEMETRY_DMA_CHANNEL       DMA1_Channel1
+
+/* conversions of each channel summed in one sample (16 -> 16-bit result) */
+#define TELEMETRY_OVERSAMPLING      16
+/* number of samples in moving average */
+#define TELEMETRY_AVERAGE           8
+
+/* factory calibration values, measured at 3.3V */
+#define VREFINT_CAL                 (*(const uint16_t *)0x1FFFF7BA)
+#define TS_CAL1                     (*(const uint16_t *)0x1FFFF7B8) /* 30 degC */
+#define CAL_VDDA                    3300    /* mV */
+#define ADC_FULL_SCALE              4095
+#define TS_SLOPE                    43      /* 4.3 mV/degC, in 0.1 mV */
+
+/* order of the channels in one scan sequence (ascending channel number) */
+enum adc_sequence {
+    SEQ_TEMPERATURE,
+    SEQ_VREFINT,
+    SEQ_LENGTH
+};
+
+static volatile uint16_t adc_samples[TELEMETRY_OVERSAMPLING][SEQ_LENGTH];
+static uint16_t average_buf[TELEMETRY_AVERAGE][SEQ_LENGTH];
+static uint32_t average_sum[SEQ_LENGTH];
+static uint8_t average_idx, average_cnt;
+
+struct st_telemetry telemetry[TELEMETRY_CHANNELS];
+
+/*******************************************************************************
+  * @function   telemetry_dma_config
+  * @brief      DMA transfers ADC results to the circular buffer.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+static void telemetry_dma_config(void)
+{
+    DMA_InitTypeDef DMA_InitStructure;
+
+    RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1, ENABLE);
+
+    DMA_DeInit(TELEMETRY_DMA_CHANNEL);
+
+    DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&TELEMETRY_ADC->DR;
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)adc_samples;
+    DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;
+    DMA_InitStructure.DMA_BufferSize = TELEMETRY_OVERSAMPLING * SEQ_LENGTH;
+    DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+    DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_HalfWord;
+    DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_HalfWord;
+    DMA_InitStructure.DMA_Mode = DMA_Mode_Circular;
+    DMA_InitStructure.DMA_Priority = DMA_Priority_Low;
+    DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+    DMA_Init(TELEMETRY_DMA_CHANNEL, &DMA_InitStructure);
+
+    DMA_Cmd(TELEMETRY_DMA_CHANNEL, ENABLE);
+}
+
+/*******************************************************************************
+  * @function   telemetry_config
+  * @brief      Start continuous ADC conversions of internal channels with DMA.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+void telemetry_config(void)
+{
+    ADC_InitTypeDef ADC_InitStructure;
+
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_ADC1, ENABLE);
+    ADC_DeInit(TELEMETRY_ADC);
+
+    telemetry_dma_config();
+
+    /* 12 MHz ADC clock (PCLK / 4), no interrupt is used */
+    ADC_ClockModeConfig(TELEMETRY_ADC, ADC_ClockMode_SynClkDiv4);
+
+    ADC_StructInit(&ADC_InitStructure);
+    ADC_InitStructure.ADC_Resolution = ADC_Resolution_12b;
+    ADC_InitStructure.ADC_ContinuousConvMode = ENABLE;
+    ADC_InitStructure.ADC_ExternalTrigConvEdge = ADC_ExternalTrigConvEdge_None;
+    ADC_InitStructure.ADC_DataAlign = ADC_DataAlign_Right;
+    ADC_InitStructure.ADC_ScanDirection = ADC_ScanDirection_Upward;
+    ADC_Init(TELEMETRY_ADC, &ADC_InitStructure);
+
+    /* temperature sensor needs at least 17.1 us sampling time */
+    ADC_ChannelConfig(TELEMETRY_ADC, ADC_Channel_TempSensor | ADC_Channel_Vrefint,
+                      ADC_SampleTime_239_5Cycles);
+    ADC_TempSensorCmd(ENABLE);
+    ADC_VrefintCmd(ENABLE);
+
+    ADC_GetCalibrationFactor(TELEMETRY_ADC);
+
+    ADC_DMARequestModeConfig(TELEMETRY_ADC, ADC_DMAMode_Circular);
+    ADC_DMACmd(TELEMETRY_ADC, ENABLE);
+
+    ADC_Cmd(TELEMETRY_ADC, ENABLE);
+    while (!ADC_GetFlagStatus(TELEMETRY_ADC, ADC_FLAG_ADRDY));
+
+    ADC_StartOfConversion(TELEMETRY_ADC);
+}
+
+/*******************************************************************************
+  * @function   telemetry_store
+  * @brief      Store filtered value and update its extremes.
+  * @param      channel: telemetry channel.
+  * @param      value: new filtered value.
+  * @retval     None.
+  *****************************************************************************/
+static void telemetry_store(telemetry_channel_t channel, int16_t value)
+{
+    struct st_telemetry *tlm = &telemetry[channel];
+
+    tlm->value = value;
+
+    /* extremes are tracked since the moving average is filled */
+    if (average_cnt < TELEMETRY_AVERAGE)
+    {
+        tlm->min = value;
+        tlm->max = value;
+        return;
+    }
+
+    if (value < tlm->min)
+        tlm->min = value;
+
+    if (value > tlm->max)
+        tlm->max = value;
+}
+
+/*******************************************************************************
+  * @function   telemetry_update
+  * @brief      Evaluate new samples, called every TELEMETRY_PERIOD. Oversampled
+  *             results are filtered by a moving average and converted to
+  *             degC and mV with factory calibration values.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+void telemetry_update(void)
+{
+    uint32_t sample[SEQ_LENGTH] = { 0 };
+    uint32_t vref, vdda, v_sense, v_30;
+    uint8_t idx, seq;
+
+    /* DMA keeps writing, the sum mixes two sequences in the worst case */
+    for (idx = 0; idx < TELEMETRY_OVERSAMPLING; idx++)
+    {
+        for (seq = 0; seq < SEQ_LENGTH; seq++)
+            sample[seq] += adc_samples[idx][seq];
+    }
+
+    for (seq = 0; seq < SEQ_LENGTH; seq++)
+    {
+        if (average_cnt == 0) /* fill the whole filter with the first sample */
+        {
+            for (idx = 0; idx < TELEMETRY_AVERAGE; idx++)
+                average_buf[idx][seq] = sample[seq];
+
+            average_sum[seq] = sample[seq] * TELEMETRY_AVERAGE;
+        }
+
+        average_sum[seq] -= average_buf[average_idx][seq];
+        average_buf[average_idx][seq] = sample[seq];
+        average_sum[seq] += sample[seq];
+    }
+
+    if (++average_idx >= TELEMETRY_AVERAGE)
+        average_idx = 0;
+
+    if (average_cnt < TELEMETRY_AVERAGE)
+        average_cnt++;
+
+    /* ADC results scaled by TELEMETRY_OVERSAMPLING */
+    vref = average_sum[SEQ_VREFINT] / TELEMETRY_AVERAGE;
+    v_sense = average_sum[SEQ_TEMPERATURE] / TELEMETRY_AVERAGE;
+
+    if (vref == 0)
+        return;
+
+    vdda = (uint32_t)CAL_VDDA * VREFINT_CAL * TELEMETRY_OVERSAMPLING / vref;
+
+    /* voltages in 0.1 mV */
+    v_30 = (uint32_t)TS_CAL1 * CAL_VDDA * 10 / ADC_FULL_SCALE;
+    v_sense = v_sense * vdda * 10 / (ADC_FULL_SCALE * TELEMETRY_OVERSAMPLING);
+
+    telemetry_store(TELEMETRY_VDDA, vdda);
+    telemetry_store(TELEMETRY_TEMPERATURE,
+                    300 + ((int32_t)v_30 - (int32_t)v_sense) * 10 / TS_SLOPE);
+}
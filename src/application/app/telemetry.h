@@ -0,0 +1,45 @@
+/**
+ ******************************************************************************
+ * @file    telemetry.h
+ * @author  CZ.NIC, z.s.p.o.
+ * @date    18-October-2026
+ * @brief   Header file for ADC telemetry (MCU temperature and supply).
+ ******************************************************************************
+ ******************************************************************************
+ **/
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#define TELEMETRY_PERIOD            100 /* ms */
+
+typedef enum telemetry_channels {
+    TELEMETRY_TEMPERATURE   = 0, /* MCU temperature [0.1 degC] */
+    TELEMETRY_VDDA          = 1, /* analog supply voltage [mV] */
+    TELEMETRY_CHANNELS
+} telemetry_channel_t;
+
+struct st_telemetry {
+    int16_t value;              /* filtered value */
+    int16_t min;                /* minimum of filtered value since start */
+    int16_t max;                /* maximum of filtered value since start */
+};
+
+extern struct st_telemetry telemetry[TELEMETRY_CHANNELS];
+
+/*******************************************************************************
+  * @function   telemetry_config
+  * @brief      Start continuous ADC conversions of internal channels with DMA.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+void telemetry_config(void);
+
+/*******************************************************************************
+  * @function   telemetry_update
+  * @brief      Evaluate new samples, called every TELEMETRY_PERIOD.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+void telemetry_update(void);
+
+#endif /* TELEMETRY_H */
@@ -0,0 +1,145 @@
+/**
+ ******************************************************************************
+ * @file    trace.c
+ * @author  CZ.NIC, z.s.p.o.
+ * @date    18-October-2026
+ * @brief   Ring buffer of system events (state changes, I2C commands, inputs,
+ *          power sequencing). It is read over I2C and converted to a timeline
+ *          by tools/trace_to_chrome.py. The buffer is kept in uninitialized
+ *          RAM over resets, so a failed power-up can be read after the MCU
+ *          restarted.
+ ******************************************************************************
+ ******************************************************************************
+ **/
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f0xx.h"
+#include "trace.h"
+#include "delay.h"
+#include "eeprom.h"
+
+#define TRACE_MAGIC                 0x7EACE0B1
+#define TRACE_INDEX(seq)            ((seq) & (TRACE_SIZE - 1))
+
+struct st_trace {
+    uint32_t magic;                 /* TRACE_MAGIC - buffer is valid */
+    uint32_t head;                  /* number of recorded events */
+    uint32_t snap_head;             /* head when page 0 was read */
+    struct st_trace_entry entry[TRACE_SIZE];
+};
+
+static struct st_trace trace __attribute__((section(".noinit.trace")));
+static uint8_t trace_checked;
+
+/*******************************************************************************
+  * @function   trace_check
+  * @brief      Start a new trace unless the buffer survived the reset. An older
+  *             bootloader uses this RAM, the buffer is not kept with it.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+static void trace_check(void)
+{
+    struct st_trace *tr = &trace;
+
+    if (trace_checked)
+        return;
+
+    if ((tr->magic != TRACE_MAGIC) || !BOOT_HAS_FEATURE(BOOT_FEATURE_NOINIT))
+    {
+        tr->head = 0;
+        tr->snap_head = 0;
+        tr->magic = TRACE_MAGIC;
+    }
+
+    trace_checked = 1;
+}
+
+/*******************************************************************************
+  * @function   trace_event
+  * @brief      Record the event, the oldest one is overwritten when the buffer
+  *             is full. May be called from interrupts.
+  * @param      event: event ID.
+  * @param      arg: event argument.
+  * @retval     None.
+  *****************************************************************************/
+void trace_event(trace_event_t event, uint16_t arg)
+{
+    struct st_trace *tr = &trace;
+    struct st_trace_entry *entry;
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+
+    trace_check();
+    entry = &tr->entry[TRACE_INDEX(tr->head++)];
+    entry->time = delay_get_uptime();
+    entry->event = event;
+    entry->arg = arg;
+
+    __set_PRIMASK(primask);
+}
+
+/*******************************************************************************
+  * @function   trace_read_page
+  * @brief      Fill I2C reply with one page of the trace, the oldest entries
+  *             first. Reading of page 0 takes a snapshot of the buffer state,
+  *             so the pages stay consistent unless the buffer wraps around.
+  * @param      page: page number.
+  * @param      buf: output buffer, 4 + TRACE_PAGE_ENTRIES * TRACE_ENTRY_SIZE B.
+  * @retval     None.
+  *****************************************************************************/
+void trace_read_page(uint8_t page, uint8_t *buf)
+{
+    struct st_trace *tr = &trace;
+    struct st_trace_entry entry;
+    uint32_t count, oldest, seq, primask;
+    uint8_t idx, valid = 0, *out = buf + 4;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    trace_check();
+
+    if (page == 0)
+        tr->snap_head = tr->head;
+
+    __set_PRIMASK(primask);
+
+    count = (tr->snap_head < TRACE_SIZE) ? tr->snap_head : TRACE_SIZE;
+    oldest = tr->snap_head - count;
+    seq = oldest + page * TRACE_PAGE_ENTRIES;
+
+    buf[0] = page;
+    buf[2] = seq & 0xFF;
+    buf[3] = (seq >> 8) & 0xFF;
+
+    for (idx = 0; idx < TRACE_PAGE_ENTRIES; idx++, seq++)
+    {
+        /* entries behind the snapshot are zeroed */
+        if ((seq - oldest) < count)
+        {
+            primask = __get_PRIMASK();
+            __disable_irq();
+            entry = tr->entry[TRACE_INDEX(seq)];
+            __set_PRIMASK(primask);
+            valid++;
+        }
+        else
+        {
+            entry.time = 0;
+            entry.event = 0;
+            entry.arg = 0;
+        }
+
+        out[0] = entry.time & 0xFF;
+        out[1] = (entry.time >> 8) & 0xFF;
+        out[2] = (entry.time >> 16) & 0xFF;
+        out[3] = entry.time >> 24;
+        out[4] = entry.event & 0xFF;
+        out[5] = entry.event >> 8;
+        out[6] = entry.arg & 0xFF;
+        out[7] = entry.arg >> 8;
+        out += TRACE_ENTRY_SIZE;
+    }
+
+    buf[1] = valid;
+}
@@ -0,0 +1,64 @@
+/**
+ ******************************************************************************
+ * @file    trace.h
+ * @author  CZ.NIC, z.s.p.o.
+ * @date    18-October-2026
+ * @brief   Header file for trace.c
+ ******************************************************************************
+ ******************************************************************************
+ **/
+#ifndef TRACE_H
+#define TRACE_H
+
+#define TRACE_SIZE                  64 /* entries, power of 2 */
+#define TRACE_ENTRY_SIZE            8  /* bytes in I2C page */
+#define TRACE_PAGE_ENTRIES          2
+#define TRACE_PAGE_COUNT            (TRACE_SIZE / TRACE_PAGE_ENTRIES)
+
+typedef enum trace_events {
+    TRACE_BOOT              = 0, /* arg: reset cause */
+    TRACE_STATE             = 1, /* arg: new system state */
+    TRACE_I2C_CMD           = 2, /* arg: command | received bytes << 8 */
+    TRACE_INPUT             = 3, /* arg: trace_input_t */
+    TRACE_REG_START         = 4, /* arg: regulator */
+    TRACE_REG_DONE          = 5, /* arg: regulator | error << 8 */
+} trace_event_t;
+
+typedef enum trace_inputs {
+    TRACE_INPUT_MAN_RES     = 0,
+    TRACE_INPUT_SYSRES_OUT  = 1,
+    TRACE_INPUT_PG          = 2,
+    TRACE_INPUT_PG_4V5      = 3,
+    TRACE_INPUT_USB30_OVC   = 4,
+    TRACE_INPUT_USB31_OVC   = 5,
+    TRACE_INPUT_BUTTON      = 6,
+} trace_input_t;
+
+struct st_trace_entry {
+    uint32_t time;                  /* uptime [ms] */
+    uint16_t event;
+    uint16_t arg;
+};
+
+/*******************************************************************************
+  * @function   trace_event
+  * @brief      Record the event, the oldest one is overwritten when the buffer
+  *             is full. May be called from interrupts.
+  * @param      event: event ID.
+  * @param      arg: event argument.
+  * @retval     None.
+  *****************************************************************************/
+void trace_event(trace_event_t event, uint16_t arg);
+
+/*******************************************************************************
+  * @function   trace_read_page
+  * @brief      Fill I2C reply with one page of the trace, the oldest entries
+  *             first. Reading of page 0 takes a snapshot of the buffer state,
+  *             so the pages stay consistent unless the buffer wraps around.
+  * @param      page: page number.
+  * @param      buf: output buffer, 4 + TRACE_PAGE_ENTRIES * TRACE_ENTRY_SIZE B.
+  * @retval     None.
+  *****************************************************************************/
+void trace_read_page(uint8_t page, uint8_t *buf);
+
+#endif /* TRACE_H */
@@ -11,6 +11,7 @@
 /* Includes ------------------------------------------------------------------*/
 #include "stm32f0xx_conf.h"
 #include "app.h"
+#include "reset_cause.h"
 
 #define APPLICATION_ADDRESS         0x08005000
 #define RAM_ADDRESS                 0x20000000
@@ -31,6 +32,9 @@ int main(void)
     volatile uint32_t *vector_table = (volatile uint32_t *)RAM_ADDRESS;
     uint32_t vector_index = 0;
 
+    /* reset flags must be taken before anything else resets the MCU */
+    reset_cause_capture();
+
     for(vector_index = 0; vector_index < 48; vector_index++)
     {
         vector_table[vector_index] = *(volatile uint32_t*)((uint32_t)APPLICATION_ADDRESS + (vector_index << 2));
@@ -69,6 +73,12 @@ void start_bootloader(void)
 
     __disable_irq();
 
+    /* bootloader has no handlers for input signal interrupts */
+    EXTI_DeInit();
+    /* stop ADC telemetry, its DMA would overwrite bootloader RAM */
+    ADC_DeInit(ADC1);
+    DMA_DeInit(DMA1_Channel1);
+
     /* Get the Bootloader stack pointer (First entry in the Bootloader vector table) */
     boot_stack = (uint32_t) *((volatile uint32_t*)BOOTLOADER_ADDRESS);
 
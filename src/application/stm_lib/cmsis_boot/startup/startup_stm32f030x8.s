@@ -97,6 +97,19 @@ LoopFillZerobss:
   cmp r2, r3
   bcc FillZerobss
 
+/* Paint the stack for the stack usage monitor (STACK_PAINT_PATTERN). */
+  ldr r2, =_sstack
+  ldr r1, =0xA5A5A5A5
+  mov r3, sp
+  b LoopPaintStack
+PaintStack:
+  str r1, [r2]
+  adds r2, r2, #4
+
+LoopPaintStack:
+  cmp r2, r3
+  bcc PaintStack
+
 /* Call the clock system intitialization function.*/
   bl  SystemInit
 /* Call static constructors */
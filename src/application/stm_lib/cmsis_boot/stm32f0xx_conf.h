@@ -33,7 +33,7 @@
 /* Comment the line below to disable peripheral header file inclusion */
 #include "stm32f0xx_adc.h"
 //#include "stm32f0xx_cec.h"
-//#include "stm32f0xx_crc.h"
+#include "stm32f0xx_crc.h"
 //#include "stm32f0xx_comp.h"
 //#include "stm32f0xx_dac.h"
 #include "stm32f0xx_dbgmcu.h"
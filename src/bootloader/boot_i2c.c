@@ -20,6 +20,11 @@
 
 
 __attribute__((section(".boot_version"))) uint8_t version[20] = VERSION;
+/* application uses the EEPROM ring, the independent watchdog and the kept
+ * trace only if the bootloader knows them */
+__attribute__((section(".boot_features"))) uint32_t boot_features[2] = {
+    BOOT_FEATURES_MAGIC, BOOT_FEATURE_EE_RING | BOOT_FEATURE_IWDG |
+    BOOT_FEATURE_NOINIT };
 
 #define I2C_SDA_SOURCE                  GPIO_PinSource7
 #define I2C_SCL_SOURCE                  GPIO_PinSource6
@@ -43,12 +48,35 @@ __attribute__((section(".boot_version"))) uint8_t version[20] = VERSION;
 #define FILE_CMP_OK                     0xBB
 #define FILE_CMP_ERROR                  0xDD
 #define ADDR_CMP                        0xFFFF
+#define ADDR_CRC                        0xFFFE
+
+/*
+ * Flashing sequence: the host writes packets of 2B address + 128B data,
+ * reads the flash back from APPLICATION_ADDRESS and writes ADDR_CMP with
+ * the result of comparison (FILE_CMP_OK/FILE_CMP_ERROR). Pages after the
+ * image are erased then.
+ *
+ * Differential update: the host writes ADDR_CRC (address only) and reads
+ * CRC32 of all USER_FLASH_PAGE_COUNT pages (4B each, little-endian, see
+ * flash_page_crc()). Packets of the sequence are written to their address
+ * (offset in the application area) then, so the host sends whole pages
+ * which differ only. The other pages are neither erased nor written. A page
+ * is erased by a packet at its start, so the host can send it again. The
+ * result is checked by ADDR_CRC again before ADDR_CMP.
+ *
+ * Packet out of the application area, misaligned packet or failed write
+ * is reported as FLASH_WRITE_ERROR and the sequence can't be confirmed.
+ */
 
 #define ONE_BYTE_EXPECTED               1
 
 struct st_i2c_status i2c_status;
 
 static uint8_t flash_erase_sts; /* indicates start of flashing */
+static uint8_t diff_update; /* packets are written to their address */
+static uint8_t write_error; /* a packet of the sequence was not written */
+static uint32_t page_crc[USER_FLASH_PAGE_COUNT];
+static uint32_t tx_address = APPLICATION_ADDRESS; /* flash or page_crc read by host */
 
 /*******************************************************************************
   * @function   boot_i2c_config
@@ -150,12 +178,11 @@ void boot_i2c_handler(void)
 {
     struct st_i2c_status *i2c_state = &i2c_status;
     static uint16_t direction;
-    static uint32_t flash_address = APPLICATION_ADDRESS;
     static uint8_t data;
 
     if (!flash_erase_sts) /* we are at the beginning again */
     {
-        flash_address = APPLICATION_ADDRESS;
+        tx_address = APPLICATION_ADDRESS;
     }
 
     /* address match interrupt */
@@ -182,7 +209,7 @@ void boot_i2c_handler(void)
     /* transmit interrupt */
     else if (I2C_GetITStatus(I2C_PERIPH_NAME, I2C_IT_TXIS) == SET)
     {
-        flash_read(&flash_address, &data);
+        flash_read(&tx_address, &data);
         I2C_SendData(I2C_PERIPH_NAME, data);
         i2c_state->tx_data_ctr++;
 
@@ -270,16 +297,25 @@ flash_i2c_states_t boot_i2c_flash_data(void)
             data[idx] = i2c_state->rx_buf[idx + DATA_START_BYTE_IDX];
         }
 
-        if (!flash_erase_sts) /* enter the flash sequence, erase pages */
+        if (!flash_erase_sts) /* enter the flash sequence, pages are erased on demand */
         {
-            flash_erase(flash_address);
+            flash_erase_start();
             flash_erase_sts = 1;
             DBG("FL_NOT_CONF\r\n");
         }
 
         if (rx_cmd == ADDR_CMP) /* flashing is complete, linux send result of comparison */
         {
-            if (data[0] == FILE_CMP_OK)
+            /* nothing of a previous longer image stays after the new one,
+             * unchanged pages of differential update are kept */
+            if (!diff_update && (flash_address != APPLICATION_ADDRESS) &&
+                flash_erase_unused())
+            {
+                write_error = 1;
+                DBG("ERASE ERR\r\n");
+            }
+
+            if ((data[0] == FILE_CMP_OK) && !write_error)
             {
                 flash_status = FLASH_WRITE_OK;
                 DBG("WRITE_OK\n\r");
@@ -292,11 +328,55 @@ flash_i2c_states_t boot_i2c_flash_data(void)
 
             flash_address = APPLICATION_ADDRESS;
             flash_erase_sts = 0;
+            diff_update = 0;
+            write_error = 0;
             i2c_state->tx_data_ctr = 0;
         }
+        else if (rx_cmd == ADDR_CRC) /* differential update, host reads CRC of pages */
+        {
+            for (idx = 0; idx < USER_FLASH_PAGE_COUNT; idx++)
+            {
+                page_crc[idx] = flash_page_crc(APPLICATION_ADDRESS + idx * FLASH_PAGE_SIZE);
+            }
+
+            tx_address = (uint32_t)page_crc;
+            diff_update = 1;
+            DBG("CRC\r\n");
+        }
         else /* write incoming data */
         {
-            flash_write(&flash_address, (uint32_t*)data, data_length);
+            if (diff_update) /* packet goes to its address */
+            {
+                flash_address = APPLICATION_ADDRESS + rx_cmd;
+            }
+
+            if (((flash_address % 4) != 0) ||
+                (flash_address + I2C_DATA_PACKET_SIZE > USER_FLASH_END_ADDRESS + 1))
+            {
+                write_error = 1;
+                DBG("ADDR ERR\r\n");
+            }
+            else
+            {
+                /* page can be sent again in this sequence */
+                if (diff_update && ((rx_cmd % FLASH_PAGE_SIZE) == 0))
+                {
+                    flash_page_rewrite(flash_address);
+                }
+
+                if (flash_write(&flash_address, (uint32_t*)data, data_length))
+                {
+                    write_error = 1;
+                    DBG("WRITE ERR\r\n");
+                }
+            }
+
+            if (write_error)
+            {
+                flash_status = FLASH_WRITE_ERROR;
+            }
+
+            tx_address = APPLICATION_ADDRESS;
         }
 
         clear_rxbuf();
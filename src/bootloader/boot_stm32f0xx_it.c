@@ -151,9 +151,9 @@ void SysTick_Handler(void)
   */
 void TIM16_IRQHandler(void)
 {
-    if (TIM_GetITStatus(DEBOUNCE_TIMER, TIM_IT_Update) != RESET)
+    if (TIM_GetITStatus(TIM16, TIM_IT_Update) != RESET)
     {
-        TIM_ClearITPendingBit(DEBOUNCE_TIMER, TIM_IT_Update);
+        TIM_ClearITPendingBit(TIM16, TIM_IT_Update);
     }
 }
 
@@ -179,8 +179,8 @@ void TIM3_IRQHandler(void)
   */
 void TIM17_IRQHandler(void)
 {
-    if (TIM_GetITStatus(USB_TIMEOUT_TIMER, TIM_IT_Update) != RESET)
-        TIM_ClearITPendingBit(USB_TIMEOUT_TIMER, TIM_IT_Update);
+    if (TIM_GetITStatus(TIM17, TIM_IT_Update) != RESET)
+        TIM_ClearITPendingBit(TIM17, TIM_IT_Update);
 }
 
 /**
@@ -193,6 +193,16 @@ void I2C2_IRQHandler(void)
     boot_i2c_handler();
 }
 
+/**
+  * @brief  This function handles DMA1 Channel 2 and 3 interrupt request.
+  * @param  None
+  * @retval None
+  */
+void DMA1_Channel2_3_IRQHandler(void)
+{
+    debug_serial_dma_handler();
+}
+
 #define LED_BLINK_TIMEOUT   8
 /**
   * @brief  This function handles TIM3 global interrupt request.
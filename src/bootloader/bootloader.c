@@ -58,8 +58,9 @@ void bootloader_init(void)
     FLASH_Unlock(); /* Unlock the Flash Program Erase controller */
     EE_Init(); /* EEPROM Init */
     flash_config();
-    TIM_DeInit(DEBOUNCE_TIMER);
-    TIM_DeInit(USB_TIMEOUT_TIMER);
+    /* timers of older applications (debounce, USB timeout) */
+    TIM_DeInit(TIM16);
+    TIM_DeInit(TIM17);
     __enable_irq();
 
     led_driver_set_colour(LED_COUNT, GREEN_COLOUR);
@@ -195,6 +196,9 @@ void bootloader(void)
     static uint8_t power_supply_failure; /* if power supply disconnection occurred */
     uint8_t system_reset;
 
+    /* independent watchdog keeps running when started by application */
+    delay_iwdg_reload();
+
     switch(next_state)
     {
         case STARTUP_MANAGER:
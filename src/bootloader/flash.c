@@ -27,8 +27,11 @@
 #include "stm32f0xx_conf.h"
 #include "flash.h"
 
+/* pages of user flash area erased in the current flashing sequence */
+static uint8_t page_erased[(USER_FLASH_PAGE_COUNT + 7) / 8];
+
 /*******************************************************************************
-  * @brief  Unlocks Flash for write access
+  * @brief  Unlocks Flash for write access and prepares CRC unit
   * @param  None
   * @retval None
   *****************************************************************************/
@@ -39,38 +42,98 @@ void flash_config(void)
 
   /* Clear all FLASH flags */
   FLASH_ClearFlag(FLASH_FLAG_EOP|FLASH_FLAG_WRPERR | FLASH_FLAG_PGERR | FLASH_FLAG_BSY);
+
+  /* CRC of pages for differential update, default configuration */
+  RCC_AHBPeriphClockCmd(RCC_AHBPeriph_CRC, ENABLE);
+  CRC_DeInit();
 }
 
 /*******************************************************************************
-  * @brief  This function does an erase of all user flash area
-  * @param  start_sector: start of user flash area
-  * @retval 0: user flash area successfully erased
-  *         1: error occurred
+  * @brief  Starts a new flashing sequence, pages of user flash area are erased
+  *         again by the first write into them
+  * @param  None
+  * @retval None
   *****************************************************************************/
-uint32_t flash_erase(uint32_t start_sector)
+void flash_erase_start(void)
 {
-  uint32_t flashaddress;
+  uint32_t idx;
 
-  flashaddress = start_sector;
+  for (idx = 0; idx < sizeof(page_erased); idx++)
+  {
+    page_erased[idx] = 0;
+  }
+}
 
-  while (flashaddress <= (uint32_t) USER_FLASH_LAST_PAGE_ADDRESS)
+/*******************************************************************************
+  * @brief  Checks whether the page is erased (all 0xFF)
+  * @param  page_address: start of the page
+  * @retval 1: page is blank
+  *         0: page contains data
+  *****************************************************************************/
+static uint32_t flash_page_is_blank(uint32_t page_address)
+{
+  uint32_t idx;
+
+  for (idx = 0; idx < FLASH_PAGE_SIZE; idx += 4)
   {
-    if (FLASH_ErasePage(flashaddress) == FLASH_COMPLETE)
+    if (*(volatile uint32_t*)(page_address + idx) != 0xFFFFFFFF)
     {
-      flashaddress += FLASH_PAGE_SIZE;
+      return (0);
     }
-    else
+  }
+
+  return (1);
+}
+
+/*******************************************************************************
+  * @brief  Erases the page of the address if it was not erased in the current
+  *         flashing sequence yet. A blank page is not erased.
+  * @param  address: address in user flash area
+  * @retval 0: page is ready for writing
+  *         1: error occurred while page erase
+  *****************************************************************************/
+static uint32_t flash_prepare_page(uint32_t address)
+{
+  uint32_t page = (address - APPLICATION_ADDRESS) / FLASH_PAGE_SIZE;
+  uint32_t page_address = APPLICATION_ADDRESS + page * FLASH_PAGE_SIZE;
+
+  if (page_erased[page / 8] & (1 << (page % 8)))
+  {
+    return (0);
+  }
+
+  if (!flash_page_is_blank(page_address))
+  {
+    if (FLASH_ErasePage(page_address) != FLASH_COMPLETE)
     {
       /* Error occurred while page erase */
       return (1);
     }
   }
+
+  page_erased[page / 8] |= 1 << (page % 8);
+
   return (0);
 }
 
+/*******************************************************************************
+  * @brief  The page of the address is erased again by the next write into it,
+  *         even if it was written in the current flashing sequence already
+  * @param  address: address in user flash area
+  * @retval None
+  *****************************************************************************/
+void flash_page_rewrite(uint32_t address)
+{
+  uint32_t page = (address - APPLICATION_ADDRESS) / FLASH_PAGE_SIZE;
+
+  page_erased[page / 8] &= ~(1 << (page % 8));
+}
+
 /*******************************************************************************
   * @brief  This function writes a data buffer in flash (data are 32-bit aligned).
   * @note   After writing data buffer, the flash content is checked.
+  * @note   A page is erased before the first write into it in the flashing
+  *         sequence (unless it is blank already).
   * @param  FlashAddress: start address for writing data buffer
   * @param  Data: pointer on data buffer
   * @param  DataLength: length of data buffer (unit is 32-bit word)
@@ -82,8 +145,14 @@ uint32_t flash_write(volatile uint32_t* flash_address, uint32_t* data, uint16_t
 {
   uint32_t i = 0;
 
-  for (i = 0; (i < data_length) && (*flash_address <= (USER_FLASH_END_ADDRESS-4)); i++)
+  for (i = 0; (i < data_length) && (*flash_address <= (USER_FLASH_END_ADDRESS-3)); i++)
   {
+    /* erase the page on demand, so erase time is spread over the transfer */
+    if (flash_prepare_page(*flash_address))
+    {
+      return (1);
+    }
+
     /* the operation will be done by word */
     if (FLASH_ProgramWord(*flash_address, *(uint32_t*)(data+i)) == FLASH_COMPLETE)
     {
@@ -106,6 +175,42 @@ uint32_t flash_write(volatile uint32_t* flash_address, uint32_t* data, uint16_t
   return (0);
 }
 
+/*******************************************************************************
+  * @brief  Erases pages which were not written in the current flashing
+  *         sequence (the rest of a previous longer image), blank pages are
+  *         not erased
+  * @param  None
+  * @retval 0: pages are erased
+  *         1: error occurred while page erase
+  *****************************************************************************/
+uint32_t flash_erase_unused(void)
+{
+  uint32_t page;
+
+  for (page = 0; page < USER_FLASH_PAGE_COUNT; page++)
+  {
+    if (flash_prepare_page(APPLICATION_ADDRESS + page * FLASH_PAGE_SIZE))
+    {
+      return (1);
+    }
+  }
+
+  return (0);
+}
+
+/*******************************************************************************
+  * @brief  Computes CRC32 of a page of user flash area by the CRC unit
+  * @param  page_address: start of the page
+  * @retval CRC32 of the page (polynomial 0x04C11DB7, initial value 0xFFFFFFFF,
+  *         32-bit words MSB first, no reflection and no final XOR)
+  *****************************************************************************/
+uint32_t flash_page_crc(uint32_t page_address)
+{
+  CRC_ResetDR();
+
+  return CRC_CalcBlockCRC((uint32_t*)page_address, FLASH_PAGE_SIZE / 4);
+}
+
 /*******************************************************************************
   * @brief  This function reads data from flash, byte after byte
   * @param  flash_address: start of selected flash area to be read
@@ -27,24 +27,37 @@
 /* define the user application size */
 #define USER_FLASH_SIZE   (USER_FLASH_END_ADDRESS - APPLICATION_ADDRESS + 1)
 
+/* number of pages of user flash area */
+#define USER_FLASH_PAGE_COUNT   (USER_FLASH_SIZE / FLASH_PAGE_SIZE)
+
 /*******************************************************************************
-  * @brief  Unlocks Flash for write access
+  * @brief  Unlocks Flash for write access and prepares CRC unit
   * @param  None
   * @retval None
   *****************************************************************************/
 void flash_config(void);
 
 /*******************************************************************************
-  * @brief  This function does an erase of all user flash area
-  * @param  start_sector: start of user flash area
-  * @retval 0: user flash area successfully erased
-  *         1: error occurred
+  * @brief  Starts a new flashing sequence, pages of user flash area are erased
+  *         again by the first write into them
+  * @param  None
+  * @retval None
+  *****************************************************************************/
+void flash_erase_start(void);
+
+/*******************************************************************************
+  * @brief  The page of the address is erased again by the next write into it,
+  *         even if it was written in the current flashing sequence already
+  * @param  address: address in user flash area
+  * @retval None
   *****************************************************************************/
-uint32_t flash_erase(uint32_t start_sector);
+void flash_page_rewrite(uint32_t address);
 
 /*******************************************************************************
   * @brief  This function writes a data buffer in flash (data are 32-bit aligned).
   * @note   After writing data buffer, the flash content is checked.
+  * @note   A page is erased before the first write into it in the flashing
+  *         sequence (unless it is blank already).
   * @param  FlashAddress: start address for writing data buffer
   * @param  Data: pointer on data buffer
   * @param  DataLength: length of data buffer (unit is 32-bit word)
@@ -54,6 +67,24 @@ uint32_t flash_erase(uint32_t start_sector);
   *****************************************************************************/
 uint32_t flash_write(volatile uint32_t* flash_address, uint32_t* data ,uint16_t data_length);
 
+/*******************************************************************************
+  * @brief  Erases pages which were not written in the current flashing
+  *         sequence (the rest of a previous longer image), blank pages are
+  *         not erased
+  * @param  None
+  * @retval 0: pages are erased
+  *         1: error occurred while page erase
+  *****************************************************************************/
+uint32_t flash_erase_unused(void);
+
+/*******************************************************************************
+  * @brief  Computes CRC32 of a page of user flash area by the CRC unit
+  * @param  page_address: start of the page
+  * @retval CRC32 of the page (polynomial 0x04C11DB7, initial value 0xFFFFFFFF,
+  *         32-bit words MSB first, no reflection and no final XOR)
+  *****************************************************************************/
+uint32_t flash_page_crc(uint32_t page_address);
+
 /*******************************************************************************
   * @brief  This function reads data from flash, byte after byte
   * @param  flash_address: start of selected flash area to be read
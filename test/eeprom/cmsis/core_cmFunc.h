@@ -0,0 +1,32 @@
+/**
+ ******************************************************************************
+ * @file    core_cmFunc.h
+ * @author  CZ.NIC, z.s.p.o.
+ * @date    18-October-2026
+ * @brief   Core functions of CMSIS for host tests, it is found before the
+ *          Cortex-M one (no interrupts on host).
+ ******************************************************************************
+ ******************************************************************************
+ **/
+#ifndef __CORE_CMFUNC_H
+#define __CORE_CMFUNC_H
+
+static inline uint32_t __get_PRIMASK(void)
+{
+    return 0;
+}
+
+static inline void __set_PRIMASK(uint32_t priMask)
+{
+    (void)priMask;
+}
+
+static inline void __disable_irq(void)
+{
+}
+
+static inline void __enable_irq(void)
+{
+}
+
+#endif /* __CORE_CMFUNC_H */
@@ -0,0 +1,197 @@
+/**
+ ******************************************************************************
+ * @file    flash_sim.c
+ * @author  CZ.NIC, z.s.p.o.
+ * @date    18-October-2026
+ * @brief   Simulated flash of the EEPROM emulation, eeprom.c is compiled for
+ *          the host and linked with it. Programming follows STM32F0: a half-
+ *          word can be programmed only if it is erased (or to 0x0000).
+ ******************************************************************************
+ ******************************************************************************
+ **/
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "flash_sim.h"
+
+long flash_sim_programs;
+long flash_sim_erases;
+uint32_t flash_sim_uptime;
+jmp_buf flash_sim_cut;
+
+static long cut_budget = -1;
+static long fail_budget = -1;
+static uint32_t first_address = FLASH_SIM_EE_BASE; /* lowest writable address */
+
+/*******************************************************************************
+  * @function   sim_map
+  * @brief      Map memory at the MCU address.
+  * @param      address: start of the area.
+  * @param      size: size of the area.
+  * @retval     Mapped area.
+  *****************************************************************************/
+static void *sim_map(uint32_t address, uint32_t size)
+{
+    void *area = mmap((void *)(uintptr_t)address, size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+
+    if (area != (void *)(uintptr_t)address)
+    {
+        perror("mmap");
+        exit(1);
+    }
+
+    return area;
+}
+
+/*******************************************************************************
+  * @function   sim_check
+  * @brief      Abort on access out of the writable pages, cut power when the
+  *             budget is spent.
+  * @param      address: programmed or erased address.
+  * @retval     None.
+  *****************************************************************************/
+static void sim_check(uint32_t address)
+{
+    if ((address < first_address) ||
+        (address >= FLASH_SIM_EE_BASE + FLASH_SIM_EE_SIZE))
+    {
+        printf("flash access out of EEPROM: %08x\n", address);
+        abort();
+    }
+
+    if (cut_budget == 0)
+        longjmp(flash_sim_cut, 1);
+
+    if (cut_budget > 0)
+        cut_budget--;
+}
+
+/*******************************************************************************
+  * @function   sim_fail
+  * @brief      Check whether the operation fails.
+  * @param      None.
+  * @retval     1 if the budget of successful operations is spent.
+  *****************************************************************************/
+static int sim_fail(void)
+{
+    if (fail_budget == 0)
+        return 1;
+
+    if (fail_budget > 0)
+        fail_budget--;
+
+    return 0;
+}
+
+/*******************************************************************************
+  * @function   flash_sim_init
+  * @brief      Map blank EEPROM pages and the bootloader with the features.
+  *             With FLASH_SIM_BOOT_LEGACY only the last two pages may be
+  *             programmed or erased.
+  * @param      boot_features: BOOT_FEATURE_* announced by the bootloader.
+  * @retval     None.
+  *****************************************************************************/
+void flash_sim_init(uint32_t boot_features)
+{
+    uint32_t *boot;
+
+    memset(sim_map(FLASH_SIM_EE_BASE, FLASH_SIM_EE_SIZE), 0xFF, FLASH_SIM_EE_SIZE);
+
+    boot = sim_map(FLASH_SIM_BOOT_BASE, FLASH_SIM_BOOT_SIZE);
+    memset(boot, 0xFF, FLASH_SIM_BOOT_SIZE);
+
+    if (boot_features != FLASH_SIM_BOOT_LEGACY)
+    {
+        boot[(BOOT_FEATURES_ADDRESS - FLASH_SIM_BOOT_BASE) / 4] = BOOT_FEATURES_MAGIC;
+        boot[(BOOT_FEATURES_ADDRESS - FLASH_SIM_BOOT_BASE) / 4 + 1] = boot_features;
+    }
+
+    if (boot_features & BOOT_FEATURE_EE_RING)
+        first_address = FLASH_SIM_EE_BASE;
+    else
+        first_address = EE_PAGE_ADDRESS(EE_PAGE_COUNT - 2);
+
+    cut_budget = -1;
+    fail_budget = -1;
+}
+
+/*******************************************************************************
+  * @function   flash_sim_power_cut
+  * @brief      Cut power (longjmp to flash_sim_cut) before the next program
+  *             or erase after the given count of them.
+  * @param      operations: allowed operations, negative value for no cut.
+  * @retval     None.
+  *****************************************************************************/
+void flash_sim_power_cut(long operations)
+{
+    cut_budget = operations;
+}
+
+/*******************************************************************************
+  * @function   flash_sim_fail
+  * @brief      Fail all programs and erases after the given count of them.
+  *             A failed program clears the half-word, a failed erase does
+  *             not change the page.
+  * @param      operations: allowed operations, negative value for no failure.
+  * @retval     None.
+  *****************************************************************************/
+void flash_sim_fail(long operations)
+{
+    fail_budget = operations;
+}
+
+/* Flash driver used by eeprom.c ---------------------------------------------*/
+FLASH_Status FLASH_ProgramHalfWord(uint32_t Address, uint16_t Data)
+{
+    uint16_t *half_word = (uint16_t *)(uintptr_t)Address;
+
+    if (Address & 1)
+    {
+        printf("misaligned program: %08x\n", Address);
+        abort();
+    }
+
+    sim_check(Address);
+
+    if ((*half_word != 0xFFFF) && (Data != 0x0000))
+        return FLASH_ERROR_PROGRAM;
+
+    /* a failed program leaves a spoiled half-word */
+    if (sim_fail())
+    {
+        *half_word = 0x0000;
+        return FLASH_ERROR_PROGRAM;
+    }
+
+    *half_word = Data;
+    flash_sim_programs++;
+
+    return FLASH_COMPLETE;
+}
+
+FLASH_Status FLASH_ErasePage(uint32_t Page_Address)
+{
+    if (Page_Address % PAGE_SIZE)
+    {
+        printf("misaligned erase: %08x\n", Page_Address);
+        abort();
+    }
+
+    sim_check(Page_Address);
+
+    if (sim_fail())
+        return FLASH_ERROR_PROGRAM;
+
+    memset((void *)(uintptr_t)Page_Address, 0xFF, PAGE_SIZE);
+    flash_sim_erases++;
+
+    return FLASH_COMPLETE;
+}
+
+uint32_t delay_get_uptime(void)
+{
+    return flash_sim_uptime;
+}
@@ -0,0 +1,59 @@
+/**
+ ******************************************************************************
+ * @file    flash_sim.h
+ * @author  CZ.NIC, z.s.p.o.
+ * @date    18-October-2026
+ * @brief   Header for simulated flash of the EEPROM emulation (host tests).
+ ******************************************************************************
+ ******************************************************************************
+ **/
+#ifndef FLASH_SIM_H
+#define FLASH_SIM_H
+
+#include <setjmp.h>
+#include "eeprom.h"
+
+/* both areas are mapped at their MCU addresses */
+#define FLASH_SIM_BOOT_BASE         0x08000000u /* bootloader, its feature word */
+#define FLASH_SIM_BOOT_SIZE         0x1000u
+#define FLASH_SIM_EE_BASE           EE_PAGE_ADDRESS(0)
+#define FLASH_SIM_EE_SIZE           (EE_PAGE_COUNT * PAGE_SIZE)
+
+/* features of an older bootloader (two pages layout, no watchdog) */
+#define FLASH_SIM_BOOT_LEGACY       0
+
+extern long flash_sim_programs; /* programmed half-words */
+extern long flash_sim_erases; /* erased pages */
+extern uint32_t flash_sim_uptime; /* returned by delay_get_uptime() */
+extern jmp_buf flash_sim_cut; /* longjmp target of the power cut */
+
+/*******************************************************************************
+  * @function   flash_sim_init
+  * @brief      Map blank EEPROM pages and the bootloader with the features.
+  *             With FLASH_SIM_BOOT_LEGACY only the last two pages may be
+  *             programmed or erased.
+  * @param      boot_features: BOOT_FEATURE_* announced by the bootloader.
+  * @retval     None.
+  *****************************************************************************/
+void flash_sim_init(uint32_t boot_features);
+
+/*******************************************************************************
+  * @function   flash_sim_power_cut
+  * @brief      Cut power (longjmp to flash_sim_cut) before the next program
+  *             or erase after the given count of them.
+  * @param      operations: allowed operations, negative value for no cut.
+  * @retval     None.
+  *****************************************************************************/
+void flash_sim_power_cut(long operations);
+
+/*******************************************************************************
+  * @function   flash_sim_fail
+  * @brief      Fail all programs and erases after the given count of them.
+  *             A failed program clears the half-word, a failed erase does
+  *             not change the page.
+  * @param      operations: allowed operations, negative value for no failure.
+  * @retval     None.
+  *****************************************************************************/
+void flash_sim_fail(long operations);
+
+#endif /* FLASH_SIM_H */
@@ -0,0 +1,281 @@
+/**
+ ******************************************************************************
+ * @file    key_value.c
+ * @author  CZ.NIC, z.s.p.o.
+ * @date    18-October-2026
+ * @brief   Host test of the key-value API of the EEPROM emulation: random
+ *          16/32 bit values and blobs are written over many page transfers
+ *          and read back, also after reboot (a new process on the same
+ *          flash). A deferred value must survive a failed direct write and
+ *          a blob must keep its data over a page transfer when it shrinks
+ *          and grows again.
+ ******************************************************************************
+ ******************************************************************************
+ **/
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "flash_sim.h"
+
+#define SESSIONS            30 /* reboots */
+#define WRITES              200 /* writes in one session */
+#define BLOB_MAX            16
+
+/* expected content, shared by all sessions */
+struct model {
+    uint8_t have_blob, have_32, have_16;
+    uint8_t blob[BLOB_MAX];
+    uint16_t blob_len;
+    uint32_t value_32;
+    uint16_t value_16;
+};
+
+static struct model *model;
+
+/*******************************************************************************
+  * @function   check
+  * @brief      Compare the EEPROM with the model, exit on difference.
+  * @param      where: name of the check point.
+  * @retval     None.
+  *****************************************************************************/
+static void check(const char *where)
+{
+    uint8_t blob[BLOB_MAX];
+    uint16_t len = 0, status, value_16;
+    uint32_t value_32;
+
+    status = EE_ReadBlob(LED_PROFILE_VIRT_ADDR, blob, sizeof(blob), &len);
+    if (model->have_blob ? (status || (len != model->blob_len) ||
+                            memcmp(blob, model->blob, len)) : (status != 1))
+    {
+        printf("%s: blob status %u length %u\n", where, status, len);
+        exit(1);
+    }
+
+    status = EE_ReadVariable32(RESET_COUNT_VIRT_ADDR, &value_32);
+    if (model->have_32 ? (status || (value_32 != model->value_32)) : (status != 1))
+    {
+        printf("%s: 32 bit value status %u\n", where, status);
+        exit(1);
+    }
+
+    status = EE_ReadVariable(RESET_VIRT_ADDR, &value_16);
+    if (model->have_16 ? (status || (value_16 != model->value_16)) : (status != 1))
+    {
+        printf("%s: 16 bit value status %u\n", where, status);
+        exit(1);
+    }
+}
+
+/*******************************************************************************
+  * @function   session
+  * @brief      Boot and do random writes.
+  * @param      seed: seed of the writes.
+  * @retval     None.
+  *****************************************************************************/
+static void session(unsigned seed)
+{
+    uint8_t blob[BLOB_MAX];
+    uint16_t status, len, idx;
+    uint32_t value;
+    int write;
+
+    srand(seed);
+
+    if (EE_Init() != FLASH_COMPLETE)
+    {
+        printf("EE_Init failed\n");
+        exit(1);
+    }
+    check("boot");
+
+    for (write = 0; write < WRITES; write++)
+    {
+        switch (rand() % 3)
+        {
+            case 0:
+                len = rand() % (BLOB_MAX + 1);
+                for (idx = 0; idx < len; idx++)
+                    blob[idx] = rand();
+
+                status = EE_WriteBlob(LED_PROFILE_VIRT_ADDR, blob, len);
+                memcpy(model->blob, blob, len);
+                model->blob_len = len;
+                model->have_blob = 1;
+                break;
+
+            case 1:
+                value = rand() ^ ((uint32_t)rand() << 16);
+                status = EE_WriteVariable32(RESET_COUNT_VIRT_ADDR, value);
+                model->value_32 = value;
+                model->have_32 = 1;
+                break;
+
+            default:
+                value = rand() & 0xFFFF;
+                status = EE_WriteVariable(RESET_VIRT_ADDR, value);
+                model->value_16 = value;
+                model->have_16 = 1;
+                break;
+        }
+
+        if (status != FLASH_COMPLETE)
+        {
+            printf("write failed %u\n", status);
+            exit(1);
+        }
+
+        if ((write % 13) == 0)
+            check("run");
+    }
+
+    check("end");
+}
+
+/*******************************************************************************
+  * @function   deferred_failure
+  * @brief      A failed write of a variable must not drop its deferred value,
+  *             EE_Flush() writes it later.
+  * @param      None.
+  * @retval     0 on success.
+  *****************************************************************************/
+static int deferred_failure(void)
+{
+    ee_record_t records[1] = { { RESET_VIRT_ADDR, 3 } };
+
+    EE_WriteVariableDeferred(RESET_VIRT_ADDR, 1);
+
+    flash_sim_fail(0);
+    if ((EE_WriteVariable(RESET_VIRT_ADDR, 2) == FLASH_COMPLETE) ||
+        (EE_WriteTransaction(records, 1) == FLASH_COMPLETE))
+    {
+        printf("write did not fail\n");
+        return 1;
+    }
+    flash_sim_fail(-1);
+
+    if (EE_Flush(0) != FLASH_COMPLETE)
+    {
+        printf("flush failed\n");
+        return 1;
+    }
+
+    model->value_16 = 1;
+    model->have_16 = 1;
+
+    return 0;
+}
+
+/*******************************************************************************
+  * @function   blob_regrow
+  * @brief      Shrink a blob, transfer the page and grow the blob to the old
+  *             data. The unchanged records are not written again, so the page
+  *             transfer must have copied them although they were behind the
+  *             length.
+  * @param      None.
+  * @retval     0 on success.
+  *****************************************************************************/
+static int blob_regrow(void)
+{
+    uint8_t blob[BLOB_MAX];
+    uint16_t idx;
+
+    for (idx = 0; idx < BLOB_MAX; idx++)
+        blob[idx] = idx + 1;
+
+    if ((EE_WriteBlob(LED_PROFILE_VIRT_ADDR, blob, BLOB_MAX) != FLASH_COMPLETE) ||
+        (EE_WriteBlob(LED_PROFILE_VIRT_ADDR, blob, 2) != FLASH_COMPLETE))
+    {
+        printf("blob write failed\n");
+        return 1;
+    }
+
+    /* more writes than records of a page */
+    for (idx = 0; idx < PAGE_SIZE / 4; idx++)
+    {
+        if (EE_WriteVariable(RESET_VIRT_ADDR, idx) != FLASH_COMPLETE)
+        {
+            printf("page transfer failed\n");
+            return 1;
+        }
+    }
+
+    if (EE_WriteBlob(LED_PROFILE_VIRT_ADDR, blob, BLOB_MAX) != FLASH_COMPLETE)
+    {
+        printf("blob write failed\n");
+        return 1;
+    }
+
+    memcpy(model->blob, blob, BLOB_MAX);
+    model->blob_len = BLOB_MAX;
+    model->have_blob = 1;
+    model->value_16 = idx - 1;
+    model->have_16 = 1;
+
+    return 0;
+}
+
+/*******************************************************************************
+  * @function   run
+  * @brief      Run all sessions with the bootloader features.
+  * @param      boot_features: BOOT_FEATURE_* of the simulated bootloader.
+  * @retval     0 on success.
+  *****************************************************************************/
+static int run(uint32_t boot_features)
+{
+    uint8_t blob[LED_PROFILE_SIZE + 1] = { 0 };
+    int stat;
+    unsigned seed;
+    pid_t pid;
+
+    flash_sim_init(boot_features);
+    memset(model, 0, sizeof(*model));
+
+    if ((EE_Init() != FLASH_COMPLETE) ||
+        (EE_WriteBlob(LED_PROFILE_VIRT_ADDR + 1, blob, 1) != VAR_BAD_KEY) ||
+        (EE_WriteBlob(LED_PROFILE_VIRT_ADDR, blob, sizeof(blob)) != VAR_BAD_KEY) ||
+        (EE_WriteVariable32(RESET_VIRT_ADDR, 0) != VAR_BAD_KEY))
+    {
+        printf("bad keys are not rejected\n");
+        return 1;
+    }
+
+    if (deferred_failure() || blob_regrow())
+        return 1;
+
+    for (seed = 0; seed < SESSIONS; seed++)
+    {
+        pid = fork();
+        if (pid == 0)
+        {
+            session(seed);
+            exit(0);
+        }
+
+        waitpid(pid, &stat, 0);
+        if (!WIFEXITED(stat) || WEXITSTATUS(stat))
+        {
+            printf("session %u failed\n", seed);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int main(void)
+{
+    model = mmap(NULL, sizeof(*model), PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    if (run(BOOT_FEATURE_EE_RING) || run(FLASH_SIM_BOOT_LEGACY))
+        return 1;
+
+    printf("key_value: OK\n");
+
+    return 0;
+}
@@ -0,0 +1,394 @@
+/**
+ ******************************************************************************
+ * @file    power_cut.c
+ * @author  CZ.NIC, z.s.p.o.
+ * @date    18-October-2026
+ * @brief   Host fault-injection test of the EEPROM emulation. A script of
+ *          writes (transactions, 32 bit values, blobs, 16 bit values) is cut
+ *          by power loss before every programmed half-word and page erase.
+ *          After reboot the EEPROM must contain the state before or after
+ *          the interrupted write, and it must keep working.
+ ******************************************************************************
+ ******************************************************************************
+ **/
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "flash_sim.h"
+
+#define OPERATIONS          160 /* writes of the script */
+#define PREFILL             200 /* writes before the script, page transfers happen in it */
+#define CONTINUE            20 /* writes done after the recovery */
+#define BLOB_MAX            16
+
+enum operation_type {
+    OP_TRANSACTION,
+    OP_VALUE_32,
+    OP_BLOB,
+    OP_VALUE_16,
+    OP_COUNT
+};
+
+struct operation {
+    enum operation_type type;
+    uint16_t value_a, value_b;
+    uint32_t value_32;
+    uint16_t len;
+    uint8_t blob[BLOB_MAX];
+};
+
+/* content of the EEPROM after an operation */
+struct state {
+    uint8_t have_wdg, have_32, have_blob, have_16;
+    uint16_t wdg, wdg_timeout, value_16;
+    uint32_t value_32;
+    uint16_t blob_len;
+    uint8_t blob[BLOB_MAX];
+};
+
+/* progress of the cut process */
+struct shared {
+    int done;
+};
+
+static struct operation script[OPERATIONS];
+static struct state model[OPERATIONS + 1];
+static struct shared *shared;
+static uint8_t snapshot[FLASH_SIM_EE_SIZE];
+
+/*******************************************************************************
+  * @function   script_generate
+  * @brief      Random script of writes and the expected states.
+  * @param      None.
+  * @retval     None.
+  *****************************************************************************/
+static void script_generate(void)
+{
+    struct operation *op;
+    struct state state;
+    int idx, byte;
+
+    srand(12345);
+    memset(&model[0], 0, sizeof(model[0]));
+
+    for (idx = 0; idx < OPERATIONS; idx++)
+    {
+        op = &script[idx];
+        state = model[idx];
+        op->type = rand() % OP_COUNT;
+
+        switch (op->type)
+        {
+            case OP_TRANSACTION:
+                op->value_a = rand() % 3;
+                op->value_b = rand() % 3;
+                state.have_wdg = 1;
+                state.wdg = op->value_a;
+                state.wdg_timeout = op->value_b;
+                break;
+
+            case OP_VALUE_32:
+                op->value_32 = (uint32_t)rand() * 7u;
+                state.have_32 = 1;
+                state.value_32 = op->value_32;
+                break;
+
+            case OP_BLOB:
+                op->len = rand() % (BLOB_MAX + 1);
+                for (byte = 0; byte < op->len; byte++)
+                    op->blob[byte] = rand() % 3;
+
+                state.have_blob = 1;
+                state.blob_len = op->len;
+                memcpy(state.blob, op->blob, op->len);
+                break;
+
+            default:
+                op->value_a = rand();
+                state.have_16 = 1;
+                state.value_16 = op->value_a;
+                break;
+        }
+
+        model[idx + 1] = state;
+    }
+}
+
+/*******************************************************************************
+  * @function   script_run
+  * @brief      Do one operation of the script.
+  * @param      idx: index of the operation.
+  * @retval     Status of the write.
+  *****************************************************************************/
+static uint16_t script_run(int idx)
+{
+    const struct operation *op = &script[idx];
+    ee_record_t records[2] = {
+        { WDG_VIRT_ADDR, op->value_a },
+        { WDG_TIMEOUT_VIRT_ADDR, op->value_b },
+    };
+
+    switch (op->type)
+    {
+        case OP_TRANSACTION: return EE_WriteTransaction(records, 2);
+        case OP_VALUE_32: return EE_WriteVariable32(RESET_COUNT_VIRT_ADDR, op->value_32);
+        case OP_BLOB: return EE_WriteBlob(LED_PROFILE_VIRT_ADDR, op->blob, op->len);
+        default: return EE_WriteVariable(RESET_VIRT_ADDR, op->value_a);
+    }
+}
+
+/*******************************************************************************
+  * @function   read_matches
+  * @brief      Check a read of a value, status 1 is expected if it was never
+  *             written.
+  * @param      have: the value was written.
+  * @param      status: status of the read.
+  * @param      equal: read value is the expected one.
+  * @retval     1 if the read matches.
+  *****************************************************************************/
+static int read_matches(int have, uint16_t status, int equal)
+{
+    return have ? ((status == 0) && equal) : (status == 1);
+}
+
+/*******************************************************************************
+  * @function   state_matches
+  * @brief      Compare the EEPROM with the expected state.
+  * @param      state: expected state.
+  * @retval     1 if all variables match.
+  *****************************************************************************/
+static int state_matches(const struct state *state)
+{
+    uint8_t blob[BLOB_MAX];
+    uint16_t status, value = 0, len = 0;
+    uint32_t value_32 = 0;
+
+    status = EE_ReadVariable(WDG_VIRT_ADDR, &value);
+    if (!read_matches(state->have_wdg, status, value == state->wdg))
+        return 0;
+
+    status = EE_ReadVariable(WDG_TIMEOUT_VIRT_ADDR, &value);
+    if (!read_matches(state->have_wdg, status, value == state->wdg_timeout))
+        return 0;
+
+    status = EE_ReadVariable(RESET_VIRT_ADDR, &value);
+    if (!read_matches(state->have_16, status, value == state->value_16))
+        return 0;
+
+    status = EE_ReadVariable32(RESET_COUNT_VIRT_ADDR, &value_32);
+    if (!read_matches(state->have_32, status, value_32 == state->value_32))
+        return 0;
+
+    status = EE_ReadBlob(LED_PROFILE_VIRT_ADDR, blob, sizeof(blob), &len);
+    if (!read_matches(state->have_blob, status, (len == state->blob_len) &&
+                      !memcmp(blob, state->blob, len)))
+        return 0;
+
+    return 1;
+}
+
+/*******************************************************************************
+  * @function   wait_child
+  * @brief      Wait for a child process.
+  * @param      pid: the child.
+  * @retval     Exit code, 255 if it crashed.
+  *****************************************************************************/
+static int wait_child(pid_t pid)
+{
+    int stat;
+
+    waitpid(pid, &stat, 0);
+
+    return WIFEXITED(stat) ? WEXITSTATUS(stat) : 255;
+}
+
+/*******************************************************************************
+  * @function   cut_run
+  * @brief      Boot and run the script until the power is cut (in a child).
+  * @param      budget: flash operations before the cut.
+  * @retval     None.
+  *****************************************************************************/
+static void cut_run(long budget)
+{
+    int idx;
+
+    shared->done = OPERATIONS;
+
+    EE_Init();
+    flash_sim_power_cut(budget);
+
+    if (setjmp(flash_sim_cut))
+        exit(0);
+
+    for (idx = 0; idx < OPERATIONS; idx++)
+    {
+        shared->done = idx;
+        script_run(idx);
+    }
+
+    shared->done = OPERATIONS;
+    exit(0);
+}
+
+/*******************************************************************************
+  * @function   cut_boot
+  * @brief      Cut power again during recovery in EE_Init (in a child).
+  * @param      budget: flash operations before the cut.
+  * @retval     None.
+  *****************************************************************************/
+static void cut_boot(long budget)
+{
+    flash_sim_power_cut(budget);
+
+    if (setjmp(flash_sim_cut))
+        exit(0);
+
+    EE_Init();
+    exit(0);
+}
+
+/*******************************************************************************
+  * @function   verify
+  * @brief      Boot after the cut, the interrupted operation is either done
+  *             or not. Continue with the script and boot again (in a child).
+  * @param      done: index of the interrupted operation.
+  * @retval     None.
+  *****************************************************************************/
+static void verify(int done)
+{
+    int idx, end, before, after;
+    pid_t pid;
+
+    if (EE_Init() != FLASH_COMPLETE)
+        exit(2);
+
+    before = state_matches(&model[done]);
+    after = !before && (done < OPERATIONS) && state_matches(&model[done + 1]);
+
+    if (!before && !after)
+        exit(1);
+
+    end = (done + CONTINUE < OPERATIONS) ? done + CONTINUE : OPERATIONS;
+
+    for (idx = before ? done : done + 1; idx < end; idx++)
+    {
+        if (script_run(idx) != FLASH_COMPLETE)
+            exit(4);
+    }
+
+    if (!state_matches(&model[end]))
+        exit(5);
+
+    pid = fork();
+    if (pid == 0)
+    {
+        EE_Init();
+        exit(!state_matches(&model[end]));
+    }
+
+    exit(wait_child(pid) ? 3 : 0);
+}
+
+/*******************************************************************************
+  * @function   run
+  * @brief      Cut the script at every flash operation.
+  * @param      boot_features: BOOT_FEATURE_* of the simulated bootloader.
+  * @param      step: cut at every step-th flash operation.
+  * @retval     Number of failed cuts.
+  *****************************************************************************/
+static long run(uint32_t boot_features, long step)
+{
+    long total, cut, runs = 0, fails = 0;
+    int idx, status;
+    pid_t pid;
+
+    flash_sim_init(boot_features);
+
+    if (EE_Init() != FLASH_COMPLETE)
+        return 1;
+
+    for (idx = 0; idx < PREFILL; idx++)
+        EE_WriteVariable(RESET_COUNT_VIRT_ADDR + 2 + (idx % (RESET_COUNT_NUM - 2)), idx);
+
+    memcpy(snapshot, (void *)FLASH_SIM_EE_BASE, sizeof(snapshot));
+
+    /* uncut run counts the flash operations */
+    EE_Init();
+    total = flash_sim_programs + flash_sim_erases;
+
+    for (idx = 0; idx < OPERATIONS; idx++)
+    {
+        if (script_run(idx) != FLASH_COMPLETE)
+        {
+            printf("operation %d failed\n", idx);
+            return 1;
+        }
+    }
+
+    if (!state_matches(&model[OPERATIONS]))
+    {
+        printf("uncut run differs\n");
+        return 1;
+    }
+
+    total = flash_sim_programs + flash_sim_erases - total;
+
+    for (cut = 0; cut <= total; cut += step)
+    {
+        memcpy((void *)FLASH_SIM_EE_BASE, snapshot, sizeof(snapshot));
+
+        pid = fork();
+        if (pid == 0)
+            cut_run(cut);
+        wait_child(pid);
+
+        /* some cuts hit the recovery too */
+        if ((cut % 7) == 3)
+        {
+            pid = fork();
+            if (pid == 0)
+                cut_boot((cut / 7) % 40);
+            wait_child(pid);
+        }
+
+        pid = fork();
+        if (pid == 0)
+            verify(shared->done);
+
+        status = wait_child(pid);
+        runs++;
+
+        if (status && (fails++ < 5))
+            printf("cut %ld in operation %d: failure %d\n", cut, shared->done, status);
+    }
+
+    printf("power_cut: %s layout, %ld cuts, %ld failed\n",
+           (boot_features & BOOT_FEATURE_EE_RING) ? "ring" : "legacy", runs, fails);
+
+    return fails;
+}
+
+int main(int argc, char **argv)
+{
+    long step = (argc > 1) ? atol(argv[1]) : 1;
+
+    if (step < 1)
+        step = 1;
+
+    /* children must not print the buffer of the parent again */
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    shared = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    script_generate();
+
+    if (run(BOOT_FEATURE_EE_RING, step) || run(FLASH_SIM_BOOT_LEGACY, step))
+        return 1;
+
+    return 0;
+}
@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+"""
+Decoder of the binary debug log of the Turris Omnia MCU firmware.
+
+DBG() sends only a message ID and raw 32 bit arguments. The ID is the address
+of the format string in the .dbg_fmt section of the firmware ELF, which is not
+loaded to the MCU. Frame format (little endian):
+
+    0xA5, number of arguments, ID (2 B), arguments (4 B each)
+
+Usage:
+    stty -F /dev/ttyUSB0 115200 raw
+    tools/dbg_decode.py omnia_hw_ctrl.elf /dev/ttyUSB0
+
+The ELF must be exactly the one running on the MCU. Use the bootloader ELF to
+decode messages from the bootloader.
+"""
+import re
+import struct
+import sys
+
+SYNC = 0xA5
+MAX_ARGS = 6
+ID_DROPPED = 0xFFFF
+CONVERSION = re.compile(r'%(\d*)([duxc%])')
+
+
+def load_formats(elf_path):
+    """Return {address: format string} of the .dbg_fmt section."""
+    with open(elf_path, 'rb') as f:
+        elf = f.read()
+
+    if elf[:4] != b'\x7fELF' or elf[4] != 1:
+        sys.exit('%s: not a 32-bit ELF file' % elf_path)
+
+    shoff, = struct.unpack_from('<I', elf, 0x20)
+    shentsize, shnum, shstrndx = struct.unpack_from('<HHH', elf, 0x2E)
+
+    def section(idx):
+        # name, type, flags, addr, offset, size
+        return struct.unpack_from('<IIIIII', elf, shoff + idx * shentsize)
+
+    strtab = section(shstrndx)[4]
+    for idx in range(shnum):
+        name, _, _, addr, offset, size = section(idx)
+        end = elf.index(b'\0', strtab + name)
+        if elf[strtab + name:end] == b'.dbg_fmt':
+            break
+    else:
+        sys.exit('%s: no .dbg_fmt section, is DBG_ENABLE set?' % elf_path)
+
+    formats = {}
+    data = elf[offset:offset + size]
+    pos = 0
+    while pos < len(data):
+        end = data.find(b'\0', pos)
+        if end < 0:
+            end = len(data)
+        if end > pos:
+            formats[addr + pos] = data[pos:end].decode('ascii', 'replace')
+        pos = end + 1
+
+    return formats
+
+
+def format_message(fmt, args):
+    """Expand the subset of printf conversions supported by DBG()."""
+    args = list(args)
+
+    def conversion(match):
+        width, conv = match.groups()
+        if conv == '%':
+            return '%'
+        value = args.pop(0) if args else 0
+        if conv == 'd' and value & 0x80000000:
+            value -= 1 << 32
+        if conv == 'c':
+            return chr(value & 0xFF)
+        if conv == 'x':
+            return format(value, '0%sx' % width if width else 'x')
+        return format(value, '0%sd' % width if width else 'd')
+
+    return CONVERSION.sub(conversion, fmt)
+
+
+def decode(stream, formats):
+    """Yield decoded messages, resynchronise on garbage."""
+    buf = b''
+    while True:
+        chunk = stream.read(1)
+        if not chunk:
+            return
+        buf += chunk
+
+        while len(buf) >= 4:
+            nargs = buf[1]
+            if buf[0] != SYNC or nargs > MAX_ARGS:
+                buf = buf[1:]
+                continue
+
+            length = 4 + 4 * nargs
+            if len(buf) < length:
+                break
+
+            msg_id, = struct.unpack_from('<H', buf, 2)
+            args = struct.unpack_from('<%dI' % nargs, buf, 4)
+
+            if msg_id == ID_DROPPED and nargs == 1:
+                yield '*** %d message(s) dropped ***\n' % args[0]
+            elif msg_id in formats:
+                yield format_message(formats[msg_id], args)
+            else:
+                # not a frame start, try the next byte
+                buf = buf[1:]
+                continue
+
+            buf = buf[length:]
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit('usage: %s <firmware.elf> <serial device or log file>'
+                 % sys.argv[0])
+
+    formats = load_formats(sys.argv[1])
+
+    with open(sys.argv[2], 'rb', buffering=0) as stream:
+        for message in decode(stream, formats):
+            sys.stdout.write(message.replace('\r\n', '\n'))
+            sys.stdout.flush()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+"""
+Read the event trace of the Turris Omnia MCU over I2C and convert it to
+Chrome trace JSON (chrome://tracing, https://ui.perfetto.dev).
+
+Usage (on the router, needs i2ctransfer from i2c-tools):
+    tools/trace_to_chrome.py > trace.json
+    tools/trace_to_chrome.py --bus 1 --address 0x2a -o trace.json
+
+Output of "i2ctransfer 1 w1@0x2A 0x20 r20" for all 32 pages (page 0 first)
+can be stored to a file and converted later with --input.
+"""
+import argparse
+import json
+import struct
+import subprocess
+import sys
+
+CMD_GET_TRACE = 0x20
+CMD_SET_TRACE_PAGE = 0x21
+PAGE_COUNT = 32
+PAGE_ENTRIES = 2
+
+EV_BOOT, EV_STATE, EV_I2C, EV_INPUT, EV_REG_START, EV_REG_DONE = range(6)
+
+STATES = ['power on', 'light reset', 'hard reset', 'load settings', 'error',
+          'running', 'bootloader']
+INPUTS = ['manual reset', 'SYSRES_OUT', 'PG', 'PG 4.5V', 'USB3.0 overcurrent',
+          'USB3.1 overcurrent', 'front button']
+REGULATORS = ['5V', '3.3V', '1.35V', '4.5V', '1.8V', '1.5V', '1.2V', 'VTT']
+
+
+def name(table, idx):
+    return table[idx] if idx < len(table) else str(idx)
+
+
+def i2c_read_pages(bus, address):
+    """Yield raw pages read over I2C, starting with page 0."""
+    def transfer(*args):
+        out = subprocess.check_output(['i2ctransfer', '-y', str(bus)] +
+                                      list(args), universal_newlines=True)
+        return bytes(int(x, 16) for x in out.split())
+
+    transfer('w2@0x%02x' % address, '0x%02x' % CMD_SET_TRACE_PAGE, '0x00')
+    for _ in range(PAGE_COUNT):
+        yield transfer('w1@0x%02x' % address, '0x%02x' % CMD_GET_TRACE, 'r20')
+
+
+def file_read_pages(path):
+    """Yield pages stored as i2ctransfer output, one page per line."""
+    with open(path) as f:
+        for line in f:
+            if line.strip():
+                yield bytes(int(x, 16) for x in line.split())
+
+
+def parse_pages(pages):
+    """Return trace entries (seq, time [ms], event, arg) in recorded order."""
+    entries = {}
+    for page in pages:
+        _, valid, seq = struct.unpack_from('<BBH', page, 0)
+        for idx in range(valid):
+            time, event, arg = struct.unpack_from('<IHH', page, 4 + 8 * idx)
+            entries[(seq + idx) & 0xFFFF] = (time, event, arg)
+
+    # sequence numbers wrap, keep the order of the MCU
+    if entries:
+        first = min(entries)
+        if max(entries) - first > 0x8000:
+            first = min(s for s in entries if s > 0x8000)
+        order = sorted(entries, key=lambda s: (s - first) & 0xFFFF)
+    else:
+        order = []
+
+    return [(s,) + entries[s] for s in order]
+
+
+def to_chrome(entries):
+    """Convert trace entries to the list of Chrome trace events."""
+    events = []
+    pid = 0
+    state = None
+    base = 0
+    last = 0
+
+    def add(ph, tid, name_, time, **args):
+        ev = {'ph': ph, 'pid': pid, 'tid': tid, 'name': name_,
+              'ts': time * 1000}
+        if ph == 'i':
+            ev['s'] = 't'
+        if args:
+            ev['args'] = args
+        events.append(ev)
+
+    for seq, time, event, arg in entries:
+        # the trace is kept over MCU resets, uptime starts again from 0
+        if base + time < last:
+            base = last
+            if state is not None:
+                add('E', 'state', name(STATES, state), base)
+                state = None
+        time += base
+        last = time
+
+        if event == EV_BOOT:
+            add('i', 'system', 'MCU start', time, reset_cause=arg)
+        elif event == EV_STATE:
+            if state is not None:
+                add('E', 'state', name(STATES, state), time)
+            state = arg
+            add('B', 'state', name(STATES, state), time)
+        elif event == EV_I2C:
+            add('i', 'i2c', 'cmd 0x%02X' % (arg & 0xFF), time,
+                data_bytes=arg >> 8)
+        elif event == EV_INPUT:
+            add('i', 'input', name(INPUTS, arg), time)
+        elif event == EV_REG_START:
+            add('B', 'power', 'regulator %s' % name(REGULATORS, arg), time)
+        elif event == EV_REG_DONE:
+            add('E', 'power', 'regulator %s' % name(REGULATORS, arg & 0xFF),
+                time, pg_error=arg >> 8)
+        else:
+            add('i', 'system', 'event %d' % event, time, arg=arg)
+
+    return events
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('--bus', type=int, default=1)
+    parser.add_argument('--address', type=lambda x: int(x, 0), default=0x2A)
+    parser.add_argument('--input', help='pages saved from i2ctransfer')
+    parser.add_argument('-o', '--output', help='output file, default stdout')
+    args = parser.parse_args()
+
+    if args.input:
+        pages = file_read_pages(args.input)
+    else:
+        pages = i2c_read_pages(args.bus, args.address)
+
+    trace = {'traceEvents': to_chrome(parse_pages(pages)),
+             'displayTimeUnit': 'ms'}
+
+    out = open(args.output, 'w') if args.output else sys.stdout
+    json.dump(trace, out, indent=1)
+    out.write('\n')
+
+
+if __name__ == '__main__':
+    main()